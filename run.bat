@@ -1,4 +1,4 @@
 setlocal
 cd build/Debug
-simple_triangle
-endlocal
\ No newline at end of file
+core_harness run
+endlocal
@@ -0,0 +1,84 @@
+#include "alloc.h"
+#include "atomics.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static atomic_i64 alloc_count = 0;
+static atomic_i64 frame_alloc_count = 0;
+static atomic_i64 alloc_bytes = 0;
+
+// Frame scope nesting and trap flag of the calling thread
+static CORE_THREAD_LOCAL unsigned frame_depth = 0;
+static CORE_THREAD_LOCAL bool frame_trap = false;
+// Inside core_malloc and friends, whose C library call an interposer
+// would otherwise report a second time
+static CORE_THREAD_LOCAL bool in_core_alloc = false;
+
+static void count_alloc(size_t size) {
+   atomic_fetch_add_i64(&alloc_count, 1);
+   atomic_fetch_add_i64(&alloc_bytes, (int64_t)size);
+   if (!frame_depth)
+      return;
+   atomic_fetch_add_i64(&frame_alloc_count, 1);
+   if (frame_trap) {
+      frame_trap = false; // fprintf may allocate
+      fprintf(stderr, "[ERROR] Heap allocation of %lu bytes inside a frame\n", (unsigned long)size);
+      fflush(stderr);
+      abort();
+   }
+}
+
+void *core_malloc(size_t size) {
+   void *ptr;
+   count_alloc(size);
+   in_core_alloc = true;
+   ptr = malloc(size);
+   in_core_alloc = false;
+   return ptr;
+}
+
+void *core_calloc(size_t count, size_t size) {
+   void *ptr;
+   count_alloc(count * size);
+   in_core_alloc = true;
+   ptr = calloc(count, size);
+   in_core_alloc = false;
+   return ptr;
+}
+
+void *core_realloc(void *ptr, size_t size) {
+   count_alloc(size);
+   in_core_alloc = true;
+   ptr = realloc(ptr, size);
+   in_core_alloc = false;
+   return ptr;
+}
+
+void core_free(void *ptr) {
+   free(ptr);
+}
+
+void core_alloc_get_stats(core_alloc_stats *stats) {
+   stats->allocs = atomic_load_i64(&alloc_count);
+   stats->frame_allocs = atomic_load_i64(&frame_alloc_count);
+   stats->bytes = atomic_load_i64(&alloc_bytes);
+}
+
+void core_alloc_frame_begin(bool trap) {
+   if (frame_depth++ == 0)
+      frame_trap = trap;
+}
+
+void core_alloc_frame_end(void) {
+   if (frame_depth && --frame_depth == 0)
+      frame_trap = false;
+}
+
+bool core_alloc_in_frame(void) {
+   return frame_depth != 0;
+}
+
+void core_alloc_note_foreign(size_t size) {
+   if (frame_depth && !in_core_alloc)
+      count_alloc(size);
+}
@@ -0,0 +1,39 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Heap entry points for everything the core allocates. They forward to the
+// C library but keep process-wide counts, so hosts can verify that
+// steady-state frames never reach the heap. Allocations the C library makes
+// for the core (qsort, stdio) are only seen if the host interposes malloc
+// and reports them with core_alloc_note_foreign; the harness does on glibc.
+void *core_malloc(size_t size);
+void *core_calloc(size_t count, size_t size);
+void *core_realloc(void *ptr, size_t size);
+void core_free(void *ptr);
+
+typedef struct core_alloc_stats {
+   int64_t allocs;       // Allocations (malloc/calloc/realloc) since startup
+   int64_t frame_allocs; // Of those, made inside a frame scope
+   int64_t bytes;        // Bytes requested
+} core_alloc_stats;
+
+void core_alloc_get_stats(core_alloc_stats *stats);
+
+// Frame scope on the calling thread: core_run and the pipeline's simulation
+// jobs. Scopes nest. With trap set, any allocation inside the scope logs
+// and aborts, leaving the offending call on the stack for a debugger.
+void core_alloc_frame_begin(bool trap);
+void core_alloc_frame_end(void);
+bool core_alloc_in_frame(void);
+
+// For a host's malloc interposer: count an allocation that didn't come
+// through core_malloc and friends. Inside a frame scope on the calling
+// thread it counts (and traps) like a core allocation; outside it is
+// ignored. Doesn't allocate.
+void core_alloc_note_foreign(size_t size);
+
+#endif // ALLOC_H
@@ -0,0 +1,85 @@
+#include "arena.h"
+#include "alloc.h"
+#include <stdint.h>
+#include <string.h>
+
+#define ALIGN_UP(n, a) (((n) + (a) - 1) & ~(size_t)((a) - 1))
+
+// Overflow blocks are chained through a header padded to keep the payload
+// aligned
+typedef struct arena_block {
+   struct arena_block *next;
+} arena_block;
+#define ARENA_BLOCK_HEADER ALIGN_UP(sizeof(arena_block), ARENA_ALIGN)
+
+static bool arena_alloc_base(frame_arena *arena, size_t capacity) {
+   // Over-allocate so base can be aligned by hand
+   unsigned char *block = (unsigned char *)core_malloc(capacity + ARENA_ALIGN);
+   if (!block)
+      return false;
+   arena->overflow = NULL;
+   arena->base = block;
+   arena->capacity = capacity;
+   return true;
+}
+
+static unsigned char *arena_aligned_base(const frame_arena *arena) {
+   return (unsigned char *)ALIGN_UP((uintptr_t)arena->base, ARENA_ALIGN);
+}
+
+bool frame_arena_init(frame_arena *arena, size_t capacity) {
+   memset(arena, 0, sizeof(*arena));
+   return arena_alloc_base(arena, ALIGN_UP(capacity, ARENA_ALIGN));
+}
+
+static void free_overflow(frame_arena *arena) {
+   arena_block *block = (arena_block *)arena->overflow;
+   while (block) {
+      arena_block *next = block->next;
+      core_free(block);
+      block = next;
+   }
+   arena->overflow = NULL;
+}
+
+void frame_arena_deinit(frame_arena *arena) {
+   free_overflow(arena);
+   core_free(arena->base);
+   memset(arena, 0, sizeof(*arena));
+}
+
+void frame_arena_reset(frame_arena *arena) {
+   if (arena->overflow) {
+      // Last frame didn't fit: grow to its size plus headroom so the next
+      // one does
+      size_t capacity = ALIGN_UP(arena->high_water + arena->high_water / 4, 4096);
+      free_overflow(arena);
+      core_free(arena->base);
+      if (!arena_alloc_base(arena, capacity)) {
+         arena->base = NULL;
+         arena->capacity = 0;
+      }
+   }
+   arena->used = 0;
+   arena->frame_bytes = 0;
+}
+
+void *frame_arena_alloc(frame_arena *arena, size_t size) {
+   size = ALIGN_UP(size, ARENA_ALIGN);
+   arena->frame_bytes += size;
+   if (arena->frame_bytes > arena->high_water)
+      arena->high_water = arena->frame_bytes;
+
+   if (arena->base && arena->used + size <= arena->capacity) {
+      void *ptr = arena_aligned_base(arena) + arena->used;
+      arena->used += size;
+      return ptr;
+   }
+
+   arena_block *block = (arena_block *)core_malloc(ARENA_BLOCK_HEADER + size);
+   if (!block)
+      return NULL;
+   block->next = (arena_block *)arena->overflow;
+   arena->overflow = block;
+   return (unsigned char *)block + ARENA_BLOCK_HEADER;
+}
@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define ARENA_ALIGN 16
+
+// Linear allocator for per-frame data. Allocation bumps a pointer and a
+// reset releases everything at once. A frame that outgrows the block is
+// served from the heap (still correct, just not free), and the next reset
+// regrows the block to the high-water mark, so allocation settles after
+// warm-up.
+typedef struct frame_arena {
+   unsigned char *base;
+   size_t capacity;
+   size_t used;        // Bytes handed out from base this frame
+   size_t frame_bytes; // Bytes requested this frame, overflow included
+   size_t high_water;  // Peak frame_bytes
+   void *overflow;     // Heap blocks serving this frame's overflow
+} frame_arena;
+
+bool frame_arena_init(frame_arena *arena, size_t capacity);
+void frame_arena_deinit(frame_arena *arena);
+void frame_arena_reset(frame_arena *arena);
+// ARENA_ALIGN-aligned; NULL only if an overflow block can't be allocated
+void *frame_arena_alloc(frame_arena *arena, size_t size);
+
+#endif // ARENA_H
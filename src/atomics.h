@@ -0,0 +1,67 @@
+#ifndef ATOMICS_H
+#define ATOMICS_H
+
+#include <stdint.h>
+#include <retro_inline.h>
+
+// Minimal sequentially-consistent atomics on 32/64-bit integers and pointers.
+// MSVC has no C11 <stdatomic.h> in C99 mode, so wrap the intrinsics.
+#if defined(_MSC_VER)
+#include <intrin.h>
+typedef volatile long atomic_i32;
+#define atomic_load_i32(p) _InterlockedOr((p), 0)
+#define atomic_store_i32(p, v) ((void)_InterlockedExchange((p), (v)))
+#define atomic_exchange_i32(p, v) _InterlockedExchange((p), (v))
+#define atomic_fetch_add_i32(p, v) _InterlockedExchangeAdd((p), (v))
+#define atomic_cas_i32(p, expected, desired) \
+   (_InterlockedCompareExchange((p), (desired), (expected)) == (expected))
+typedef volatile __int64 atomic_i64;
+#define atomic_load_i64(p) _InterlockedOr64((p), 0)
+#define atomic_store_i64(p, v) ((void)_InterlockedExchange64((p), (v)))
+#define atomic_fetch_add_i64(p, v) _InterlockedExchangeAdd64((p), (v))
+#define atomic_cas_i64(p, expected, desired) \
+   (_InterlockedCompareExchange64((p), (desired), (expected)) == (expected))
+#define atomic_load_ptr(p) _InterlockedCompareExchangePointer((void *volatile *)(p), NULL, NULL)
+#define atomic_store_ptr(p, v) ((void)_InterlockedExchangePointer((void *volatile *)(p), (v)))
+#define cpu_relax() _mm_pause()
+#else
+typedef volatile int32_t atomic_i32;
+#define atomic_load_i32(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define atomic_store_i32(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_exchange_i32(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_fetch_add_i32(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_cas_i32(p, expected, desired) \
+   __sync_bool_compare_and_swap((p), (expected), (desired))
+typedef volatile int64_t atomic_i64;
+#define atomic_load_i64(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define atomic_store_i64(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_fetch_add_i64(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#define atomic_cas_i64(p, expected, desired) \
+   __sync_bool_compare_and_swap((p), (expected), (desired))
+#define atomic_load_ptr(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#define atomic_store_ptr(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#if defined(__i386__) || defined(__x86_64__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() ((void)0)
+#endif
+#endif
+
+// Thread-local storage qualifier
+#if defined(_MSC_VER)
+#define CORE_THREAD_LOCAL __declspec(thread)
+#else
+#define CORE_THREAD_LOCAL __thread
+#endif
+
+// Process-wide spinlock for short critical sections (e.g. loading glad)
+static INLINE void spin_lock(atomic_i32 *lock) {
+   while (atomic_exchange_i32(lock, 1))
+      cpu_relax();
+}
+
+static INLINE void spin_unlock(atomic_i32 *lock) {
+   atomic_store_i32(lock, 0);
+}
+
+#endif // ATOMICS_H
@@ -0,0 +1,254 @@
+#include "commands.h"
+#include <string.h>
+
+typedef struct sort_entry {
+   uint64_t key;
+   uint32_t index;
+} sort_entry;
+
+void command_buffer_begin(command_buffer *cb, frame_arena *arena, unsigned capacity) {
+   memset(cb, 0, sizeof(*cb));
+   cb->arena = arena;
+   cb->capacity = capacity ? capacity : 64;
+   cb->commands = (render_command *)frame_arena_alloc(arena, cb->capacity * sizeof(render_command));
+   if (!cb->commands) {
+      cb->capacity = 0;
+      cb->overflowed = true;
+   }
+}
+
+static render_command *push(command_buffer *cb) {
+   if (cb->count == cb->capacity) {
+      // Move to a block twice the size; the old one is reclaimed with the
+      // rest of the arena at the next reset
+      unsigned capacity = cb->capacity ? cb->capacity * 2 : 64;
+      render_command *commands = (render_command *)frame_arena_alloc(cb->arena, capacity * sizeof(render_command));
+      if (!commands) {
+         cb->overflowed = true;
+         return NULL;
+      }
+      if (cb->count)
+         memcpy(commands, cb->commands, cb->count * sizeof(render_command));
+      cb->commands = commands;
+      cb->capacity = capacity;
+   }
+   return &cb->commands[cb->count++];
+}
+
+// Paint order of the next draw in layer; saturates rather than wrapping
+// into the next layer
+static uint32_t next_paint(command_buffer *cb, unsigned layer) {
+   unsigned order;
+   layer &= (1u << RENDER_LAYER_BITS) - 1;
+   order = cb->layer_count[layer];
+   if (order < (1u << RENDER_ORDER_BITS) - 1)
+      cb->layer_count[layer]++;
+   return (layer << RENDER_ORDER_BITS) | order;
+}
+
+static uint64_t make_key(uint32_t state, uint32_t paint) {
+   uint64_t pass = RENDER_STATE_PASS(state);
+   uint64_t program = RENDER_STATE_PROGRAM(state);
+   uint64_t texture = state & 0xffff;
+   if (pass == RENDER_PASS_OPAQUE)
+      return (pass << 62) | (program << 56) | (texture << 40) | ((uint64_t)(RENDER_PAINT_MAX - paint) << 16);
+   return (pass << 62) | ((uint64_t)paint << 38) | (program << 32) | (texture << 16);
+}
+
+static void classify(render_command *cmd, unsigned layer, unsigned program,
+      uint32_t texture, unsigned blend, bool opaque, command_buffer *cb) {
+   cmd->paint = next_paint(cb, layer);
+   cmd->texture = texture;
+   if (opaque && blend == RENDER_BLEND_ALPHA)
+      cmd->state = RENDER_STATE(RENDER_PASS_OPAQUE, RENDER_BLEND_OPAQUE, program, texture);
+   else
+      cmd->state = RENDER_STATE(RENDER_PASS_TRANSLUCENT, blend, program, texture);
+   cmd->key = make_key(cmd->state, cmd->paint);
+}
+
+void command_buffer_push_quad(command_buffer *cb, unsigned layer, unsigned program,
+      uint32_t texture, unsigned blend, float x, float y, float w, float h, uint32_t color) {
+   render_command *cmd = push(cb);
+   if (!cmd)
+      return;
+   classify(cmd, layer, program, texture, blend, (color >> 24) == 0xff, cb);
+   cmd->type = RENDER_CMD_QUAD;
+   cmd->u.quad.x = x;
+   cmd->u.quad.y = y;
+   cmd->u.quad.w = w;
+   cmd->u.quad.h = h;
+   cmd->u.quad.color = color;
+}
+
+void command_buffer_push_streams(command_buffer *cb, unsigned layer, unsigned program,
+      uint32_t texture, unsigned blend, const quad_streams *streams) {
+   render_command *cmd;
+   uint32_t alpha = 0xff;
+   unsigned i;
+   if (!streams->count || !(cmd = push(cb)))
+      return;
+   for (i = 0; i < streams->count; i++)
+      alpha &= streams->color[i] >> 24;
+   classify(cmd, layer, program, texture, blend, alpha == 0xff && !streams->uv, cb);
+   cmd->type = RENDER_CMD_QUAD_STREAM;
+   cmd->u.stream = *streams;
+   // One depth for the whole stream: with LEQUAL testing, later instances
+   // still paint over earlier ones
+   cmd->u.stream.depth = NULL;
+   cmd->u.stream.const_depth = RENDER_PAINT_DEPTH(cmd->paint);
+}
+
+void command_buffer_push_tilemap(command_buffer *cb, unsigned layer, unsigned blend,
+      struct tilemap *map, float cam_x, float cam_y, bool opaque) {
+   render_command *cmd = push(cb);
+   if (!cmd)
+      return;
+   classify(cmd, layer, RENDER_PROGRAM_TILEMAP, 0, blend, opaque, cb);
+   cmd->type = RENDER_CMD_TILEMAP;
+   cmd->u.tilemap.map = map;
+   cmd->u.tilemap.cam_x = cam_x;
+   cmd->u.tilemap.cam_y = cam_y;
+}
+
+void command_buffer_push_particles(command_buffer *cb, unsigned layer, unsigned blend,
+      struct particle_system *system, const struct particle_emitter *emitter, float cam_x, float cam_y) {
+   render_command *cmd = push(cb);
+   if (!cmd)
+      return;
+   classify(cmd, layer, RENDER_PROGRAM_PARTICLES, 0, blend, false, cb);
+   cmd->type = RENDER_CMD_PARTICLES;
+   cmd->u.particles.system = system;
+   cmd->u.particles.emitter = emitter;
+   cmd->u.particles.cam_x = cam_x;
+   cmd->u.particles.cam_y = cam_y;
+}
+
+// LSD radix sort, one byte per pass. Stable, so draws with equal keys keep
+// their recording order. Passes where every key has the same byte are
+// skipped, which with mostly-zero keys is most of them.
+static sort_entry *radix_sort(sort_entry *entries, sort_entry *scratch, unsigned count) {
+   unsigned shift;
+   for (shift = 0; shift < 64; shift += 8) {
+      unsigned offsets[256] = { 0 };
+      unsigned i, sum = 0;
+      for (i = 0; i < count; i++)
+         offsets[(entries[i].key >> shift) & 0xff]++;
+      if (offsets[(entries[0].key >> shift) & 0xff] == count)
+         continue;
+      for (i = 0; i < 256; i++) {
+         unsigned n = offsets[i];
+         offsets[i] = sum;
+         sum += n;
+      }
+      for (i = 0; i < count; i++)
+         scratch[offsets[(entries[i].key >> shift) & 0xff]++] = entries[i];
+      sort_entry *tmp = entries;
+      entries = scratch;
+      scratch = tmp;
+   }
+   return entries;
+}
+
+void command_buffer_push_vector(command_buffer *cb, unsigned layer, unsigned blend,
+      struct vector_cache *cache, const struct vector_path *path, const struct vector_style *style,
+      float x, float y, float scale) {
+   render_command *cmd = push(cb);
+   if (!cmd)
+      return;
+   classify(cmd, layer, RENDER_PROGRAM_VECTOR, 0, blend, false, cb);
+   cmd->type = RENDER_CMD_VECTOR;
+   cmd->u.vector.cache = cache;
+   cmd->u.vector.path = path;
+   cmd->u.vector.style = style;
+   cmd->u.vector.x = x;
+   cmd->u.vector.y = y;
+   cmd->u.vector.scale = scale;
+}
+
+void command_buffer_finish(command_buffer *cb) {
+   unsigned i, j;
+   cb->num_batches = 0;
+   if (!cb->count)
+      return;
+
+   sort_entry *entries = (sort_entry *)frame_arena_alloc(cb->arena, cb->count * sizeof(sort_entry));
+   sort_entry *scratch = (sort_entry *)frame_arena_alloc(cb->arena, cb->count * sizeof(sort_entry));
+   cb->batches = (render_batch *)frame_arena_alloc(cb->arena, cb->count * sizeof(render_batch));
+   if (!entries || !scratch || !cb->batches) {
+      cb->overflowed = true;
+      cb->count = 0;
+      return;
+   }
+   for (i = 0; i < cb->count; i++) {
+      entries[i].key = cb->commands[i].key;
+      entries[i].index = i;
+   }
+   entries = radix_sort(entries, scratch, cb->count);
+
+   for (i = 0; i < cb->count; i = j) {
+      const render_command *first = &cb->commands[entries[i].index];
+      render_batch *batch = &cb->batches[cb->num_batches++];
+      batch->state = first->state;
+      batch->texture = first->texture;
+      j = i + 1;
+
+      if (first->type == RENDER_CMD_QUAD_STREAM) {
+         batch->instanced = true;
+         batch->streams = first->u.stream;
+         continue;
+      }
+      if (first->type == RENDER_CMD_TILEMAP || first->type == RENDER_CMD_PARTICLES ||
+            first->type == RENDER_CMD_VECTOR) {
+         batch->instanced = false;
+         batch->single = first;
+         continue;
+      }
+
+      // Extend the run over quads sharing this state
+      while (j < cb->count) {
+         const render_command *next = &cb->commands[entries[j].index];
+         if (next->type != RENDER_CMD_QUAD || next->state != first->state ||
+               next->texture != first->texture)
+            break;
+         j++;
+      }
+      if (j - i == 1) {
+         batch->instanced = false;
+         batch->single = first;
+         continue;
+      }
+
+      // Pack the run into streams (quad_batch wants centers); each quad
+      // keeps its own depth
+      unsigned n = j - i, k;
+      float *x = (float *)frame_arena_alloc(cb->arena, n * sizeof(float));
+      float *y = (float *)frame_arena_alloc(cb->arena, n * sizeof(float));
+      float *w = (float *)frame_arena_alloc(cb->arena, n * sizeof(float));
+      float *h = (float *)frame_arena_alloc(cb->arena, n * sizeof(float));
+      uint32_t *color = (uint32_t *)frame_arena_alloc(cb->arena, n * sizeof(uint32_t));
+      float *depth = (float *)frame_arena_alloc(cb->arena, n * sizeof(float));
+      if (!x || !y || !w || !h || !color || !depth) {
+         cb->overflowed = true;
+         cb->num_batches--;
+         continue;
+      }
+      for (k = 0; k < n; k++) {
+         const render_command *cmd = &cb->commands[entries[i + k].index];
+         w[k] = cmd->u.quad.w;
+         h[k] = cmd->u.quad.h;
+         x[k] = cmd->u.quad.x + cmd->u.quad.w * 0.5f;
+         y[k] = cmd->u.quad.y + cmd->u.quad.h * 0.5f;
+         color[k] = cmd->u.quad.color;
+         depth[k] = RENDER_PAINT_DEPTH(cmd->paint);
+      }
+      batch->instanced = true;
+      batch->streams.count = n;
+      batch->streams.x = x;
+      batch->streams.y = y;
+      batch->streams.w = w;
+      batch->streams.h = h;
+      batch->streams.color = color;
+      batch->streams.depth = depth;
+      batch->streams.uv = NULL;
+   }
+}
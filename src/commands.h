@@ -0,0 +1,161 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Draws are classified into two passes as they are recorded: quads that
+// are fully opaque (alpha 255, alpha blending) go to the opaque pass, the
+// rest to the translucent pass.
+//
+// Every draw gets a paint order, (layer, recording order), that decides
+// what ends up on top. It becomes the draw's depth, with topmost nearest.
+// The opaque pass draws with depth test and writes so early-Z rejects
+// hidden pixels, which lets it ignore paint order and sort by state, then
+// front to back. The translucent pass then draws back to front (paint
+// order) over it, testing but not writing depth.
+//
+// 64-bit sort key, most significant field first:
+//   opaque:      pass (2) | program (6) | texture (16) | depth, nearest first (24) | unused (16)
+//   translucent: pass (2) | paint order (24) | program (6) | texture (16) | unused (16)
+#define RENDER_LAYER_BITS 4
+#define RENDER_ORDER_BITS 20 // Draws per layer before paint order saturates
+#define RENDER_PAINT_MAX ((1u << (RENDER_LAYER_BITS + RENDER_ORDER_BITS)) - 1)
+
+enum render_pass {
+   RENDER_PASS_OPAQUE = 0,
+   RENDER_PASS_TRANSLUCENT
+};
+
+enum render_blend {
+   RENDER_BLEND_OPAQUE = 0, // Used by the opaque pass only
+   RENDER_BLEND_ALPHA,
+   RENDER_BLEND_ADDITIVE
+};
+
+enum render_program {
+   RENDER_PROGRAM_QUAD = 1, // Solid colored quads (solid program or quad batch)
+   RENDER_PROGRAM_TILEMAP,
+   RENDER_PROGRAM_PARTICLES,
+   RENDER_PROGRAM_TEXT,     // SDF glyphs (quad batch SDF program)
+   RENDER_PROGRAM_VECTOR
+};
+
+// GL state a batch needs; draws merge only when it matches
+#define RENDER_STATE(pass, blend, program, texture) \
+   (((uint32_t)(pass) << 30) | ((uint32_t)((blend) & 0x3) << 28) | \
+    ((uint32_t)((program) & 0x3f) << 16) | ((uint32_t)(texture) & 0xffff))
+#define RENDER_STATE_PASS(state) ((unsigned)((state) >> 30))
+#define RENDER_STATE_BLEND(state) ((unsigned)((state) >> 28) & 0x3)
+#define RENDER_STATE_PROGRAM(state) ((unsigned)((state) >> 16) & 0x3f)
+
+// Window-space depth (glDepthRange 0..1) of a paint order: topmost nearest
+#define RENDER_PAINT_DEPTH(paint) (1.0f - (float)((paint) + 1) * (1.0f / 16777216.0f))
+
+enum render_command_type {
+   RENDER_CMD_QUAD,       // One quad
+   RENDER_CMD_QUAD_STREAM, // SoA quad streams, drawn instanced
+   RENDER_CMD_TILEMAP,     // Visible chunks of a tilemap
+   RENDER_CMD_PARTICLES,   // A GPU particle system
+   RENDER_CMD_VECTOR       // A cached vector path mesh
+};
+
+struct tilemap;
+struct particle_system;
+struct particle_emitter;
+struct vector_cache;
+struct vector_path;
+struct vector_style;
+
+// Quad streams as quad_batch consumes them: center x/y, size w/h (pixels),
+// packed RGBA8 color, optional per-instance window-space depth (NULL
+// draws every instance at const_depth) and, for SDF glyphs, the top-left
+// atlas coordinate as two unsigned normalized 16-bit values
+typedef struct quad_streams {
+   unsigned count;
+   const float *x, *y, *w, *h;
+   const uint32_t *color;
+   const float *depth;
+   float const_depth;
+   const uint32_t *uv;
+} quad_streams;
+
+typedef struct render_command {
+   uint64_t key;
+   uint32_t state;   // RENDER_STATE
+   uint32_t texture; // GL texture name (0 = none)
+   uint32_t paint;   // Paint order
+   unsigned type;    // enum render_command_type
+   union {
+      struct {
+         float x, y, w, h; // Top-left corner and size, pixels
+         uint32_t color;
+      } quad;
+      quad_streams stream;
+      struct {
+         struct tilemap *map;
+         float cam_x, cam_y; // View's top-left corner, world pixels
+      } tilemap;
+      struct {
+         struct particle_system *system;
+         const struct particle_emitter *emitter; // Size and color
+         float cam_x, cam_y;
+      } particles;
+      struct {
+         struct vector_cache *cache;
+         const struct vector_path *path;
+         const struct vector_style *style;
+         float x, y, scale; // Path origin on screen, pixels per path unit
+      } vector;
+   } u;
+} render_command;
+
+// What replay issues: one set of state and its draws. A run of merged
+// quads becomes one instanced batch; a lone quad, a tilemap, a particle
+// system or a vector path stays a single command.
+typedef struct render_batch {
+   uint32_t state;
+   uint32_t texture;
+   bool instanced;
+   const render_command *single; // When !instanced
+   quad_streams streams;         // When instanced
+} render_batch;
+
+// Draws recorded during simulation, sorted and merged into batches before
+// submission. All storage comes from the frame arena.
+typedef struct command_buffer {
+   frame_arena *arena;
+   render_command *commands;
+   unsigned count, capacity;
+   unsigned layer_count[1 << RENDER_LAYER_BITS]; // Draws recorded per layer
+   render_batch *batches;
+   unsigned num_batches;
+   bool overflowed; // Arena ran dry; some commands were dropped
+} command_buffer;
+
+void command_buffer_begin(command_buffer *cb, frame_arena *arena, unsigned capacity);
+// Layers paint in increasing order; blend applies if the quad turns out
+// translucent
+void command_buffer_push_quad(command_buffer *cb, unsigned layer, unsigned program,
+      uint32_t texture, unsigned blend, float x, float y, float w, float h, uint32_t color);
+// A stream is opaque only if every instance is and it has no atlas
+// coordinates (sampled coverage has soft edges)
+void command_buffer_push_streams(command_buffer *cb, unsigned layer, unsigned program,
+      uint32_t texture, unsigned blend, const quad_streams *streams);
+// Opaque only if every palette entry the map uses is; the map is read on
+// submission, after any edits recorded for the frame
+void command_buffer_push_tilemap(command_buffer *cb, unsigned layer, unsigned blend,
+      struct tilemap *map, float cam_x, float cam_y, bool opaque);
+// Always translucent
+void command_buffer_push_particles(command_buffer *cb, unsigned layer, unsigned blend,
+      struct particle_system *system, const struct particle_emitter *emitter, float cam_x, float cam_y);
+// Always translucent (edges fade out); path and style are read on
+// submission
+void command_buffer_push_vector(command_buffer *cb, unsigned layer, unsigned blend,
+      struct vector_cache *cache, const struct vector_path *path, const struct vector_style *style,
+      float x, float y, float scale);
+// Radix-sort by key and merge adjacent compatible quads into batches
+void command_buffer_finish(command_buffer *cb);
+
+#endif // COMMANDS_H
@@ -0,0 +1,197 @@
+#ifndef CORE_H
+#define CORE_H
+
+#include <libretro.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+#include "readback.h"
+#include "gpu.h"
+#include "atomics.h"
+#include "jobs.h"
+#include "entities.h"
+#include "quad_batch.h"
+#include "pipeline.h"
+#include "tilemap.h"
+#include "spatial_grid.h"
+#include "particles.h"
+#include "text.h"
+#include "vector.h"
+#include "debug_draw.h"
+#include "render_graph.h"
+#include "post.h"
+#include "soft.h"
+
+// Framebuffer dimensions
+#define WIDTH 320
+#define HEIGHT 240
+#define HW_WIDTH 512  // Match RetroArch HW render size
+#define HW_HEIGHT 512
+#define VECTOR_ART_PATHS 4 // Paths in the vector overlay
+
+// Command replay counters, accumulated over frames
+typedef struct render_stats {
+   uint64_t frames;
+   uint64_t commands;      // Draws recorded
+   uint64_t draws;         // Draw calls issued after merging
+   uint64_t opaque_draws;  // Of which in the depth-writing opaque pass
+   uint64_t tile_chunks;   // Of which tilemap chunks
+   uint64_t instances;     // Quads drawn by instanced batches
+   uint64_t state_changes; // Pass, blend, texture and program switches
+   uint64_t tessellations; // Vector meshes built on cache misses
+   uint64_t indirect_draws; // Meshes drawn through multi-draw indirect
+   uint64_t debug_dropped; // Debug primitives that didn't fit their frame
+   uint64_t passes;        // Render graph passes executed
+   uint64_t culled_passes; // Render graph passes culled as unused
+   uint64_t render_targets; // Pooled targets created since the context was made
+   uint64_t post_gpu_ns[POST_STAGES];      // Measured GPU time per post stage
+   uint64_t post_gpu_samples[POST_STAGES]; // Frames measured per stage
+} render_stats;
+
+// Where the last context reset spent its time
+typedef struct startup_stats {
+   uint64_t context_reset_usec; // All of init_opengl
+   uint64_t gl_load_usec;       // Entry points and version flags
+   unsigned gl_lookups;         // get_proc_address calls they took
+   bool gl_cached;              // Loaded from the table of an earlier reset
+   uint64_t shader_usec;        // Compiling and linking, since the reset
+   unsigned programs;           // Linked since the reset
+} startup_stats;
+
+// One core instance. Everything that used to be a file-scope static in
+// lib.c lives here so several instances can share a process (and threads).
+typedef struct core {
+   // Frontend callbacks
+   retro_environment_t environ_cb;
+   retro_log_printf_t log_cb;
+   retro_video_refresh_t video_cb;
+   retro_input_poll_t input_poll_cb;
+   retro_input_state_t input_state_cb;
+   retro_hw_get_current_framebuffer_t get_current_framebuffer;
+   retro_hw_get_proc_address_t get_proc_address;
+   struct retro_hw_render_callback hw_render;
+
+   // Lifecycle
+   bool initialized;
+   FILE *log_file;
+   bool first_frame_logged;
+
+   // OpenGL state
+   GLuint solid_shader_program;
+   GLint solid_color_loc, solid_target_loc;
+   GLuint vbo, vao;
+   bool gl_initialized;
+   unsigned hw_context;   // Context type negotiated at load, RETRO_HW_CONTEXT_NONE = software
+   bool gles;             // The frontend gave a GLES 3 context
+   soft_renderer soft;    // Draws the frames when no context was offered
+   gpu_caps gpu;          // Detected at each context reset
+   bool gl_baseline;      // Requested by the GL backend option
+   bool use_default_fbo; // Prefer frontend FBO
+
+   // Scene state
+   float animation_time; // For pulsing animation
+   entity_store entities;
+   unsigned entity_count; // Requested by the entity count option
+   quad_batch quads;      // Draws the entity store
+   spatial_grid entity_grid; // Culls entities to the view
+   particle_system particles;
+   unsigned particle_count; // Requested by the particle count option
+   tilemap tilemap;       // Scrolling background, when enabled
+   bool tilemap_enabled;  // Requested by the tilemap option
+   vector_cache vectors;  // Meshes for the vector overlay
+   vector_path vector_art[VECTOR_ART_PATHS];
+   bool vector_art_enabled; // Requested by the vector art option
+   text_renderer text;    // SDF text overlay, when enabled
+   bool text_hud;         // Requested by the text HUD option
+   debug_draw_renderer debug_renderer; // Flushes each frame's debug shapes
+   bool debug_overlay;    // Requested by the debug overlay option
+   render_graph graph;    // Rebuilt every frame
+   render_target_pool render_targets; // Transient textures behind the graph
+   post_chain post;       // Bloom and blur passes
+   post_settings post_settings; // Effects requested by the post options
+
+   render_stats render_stats;
+   startup_stats startup_stats;
+
+   // Simulation runs ahead of submission through a ring of render lists
+   frame_pipeline pipeline;
+   unsigned pipeline_depth; // Requested by the pipeline depth option
+   uint64_t frames_run;
+   bool trap_frame_allocs; // Abort on heap allocations in frames after warm-up
+
+   // Offline render mode: uncapped frames into an offscreen FBO, streamed
+   // out through the async readback ring instead of paced by video_cb
+   bool offline_mode;
+   unsigned offline_frames_per_run;
+   bool offline_to_file;
+   GLuint offline_fbo, offline_color_tex, offline_depth_rb;
+   readback_ring readback;
+   uint64_t offline_frame_index;
+   core_frame_sink_t frame_sink;
+   void *frame_sink_user;
+   FILE *offline_file;
+
+   // Job system running the pipeline's simulation and entity updates
+   job_system_t *jobs;
+   unsigned job_threads; // Workers besides the instance thread
+   bool job_affinity;
+
+   // Opaque pointer owned by the host (see core_set_userdata)
+   void *userdata;
+} core_t;
+
+// Instance management
+core_t *core_create(void);
+void core_destroy(core_t *core);
+
+// Binds an instance to the calling thread. Every core_* entry point binds
+// its instance, so callbacks the core makes into the host (environment,
+// get_current_framebuffer, ...) can find it again through core_current().
+void core_bind(core_t *core);
+core_t *core_current(void);
+
+// Instance used by the libretro shim when no instance is bound to the
+// calling thread (e.g. a frontend calling context_reset from another thread).
+void core_set_default(core_t *core);
+
+void core_set_userdata(core_t *core, void *userdata);
+// Receives every frame rendered in offline mode. Without a sink, frames go to
+// <save dir>/offline_frames.rgba when the offline output option says so.
+void core_set_frame_sink(core_t *core, core_frame_sink_t sink, void *user);
+void *core_get_userdata(const core_t *core);
+// Frame pipeline counters since the last depth change (waits for the
+// frame being simulated)
+void core_get_pipeline_stats(core_t *core, pipeline_stats *stats);
+void core_get_render_stats(const core_t *core, render_stats *stats);
+// Capabilities of the current context; all false before the first reset
+void core_get_gpu_caps(const core_t *core, gpu_caps *caps);
+// Timings of the last context reset; zero before the first
+void core_get_startup_stats(const core_t *core, startup_stats *stats);
+
+// Libretro entry points, per instance
+void core_set_environment(core_t *core, retro_environment_t cb);
+void core_set_video_refresh(core_t *core, retro_video_refresh_t cb);
+void core_set_input_poll(core_t *core, retro_input_poll_t cb);
+void core_set_input_state(core_t *core, retro_input_state_t cb);
+void core_init(core_t *core);
+void core_deinit(core_t *core);
+void core_get_system_info(struct retro_system_info *info);
+void core_get_system_av_info(core_t *core, struct retro_system_av_info *info);
+void core_reset(core_t *core);
+bool core_load_game(core_t *core, const struct retro_game_info *game);
+void core_unload_game(core_t *core);
+void core_run(core_t *core);
+
+// HW render context callbacks
+void core_context_reset(core_t *core);
+void core_context_destroy(core_t *core);
+
+// GL helpers shared by the renderer modules; errors go to the instance log
+GLuint core_create_shader_program(core_t *core, const char *vs_src, const char *fs_src, const char *name);
+// Vertex-only program whose outputs are captured by transform feedback
+// (interleaved, in varyings order)
+GLuint core_create_feedback_program(core_t *core, const char *vs_src, const char *const *varyings,
+      unsigned num_varyings, const char *name);
+void core_check_gl_error(core_t *core, const char *context);
+
+#endif // CORE_H
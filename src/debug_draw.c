@@ -0,0 +1,210 @@
+#include "debug_draw.h"
+
+#if CORE_DEBUG_DRAW
+
+#include "core.h"
+#include "alloc.h"
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define CIRCLE_MIN_SEGMENTS 12
+#define CIRCLE_MAX_SEGMENTS 64
+#define CIRCLE_SEGMENT_PIXELS 4.0f // Chord length to aim for
+
+static const char *debug_vertex_shader_src =
+   "#version 330 core\n"
+   "layout(location = 0) in vec2 position;\n"
+   "layout(location = 1) in vec4 color;\n"
+   "uniform vec2 viewport;\n"
+   "out vec4 v_color;\n"
+   "void main() {\n"
+   "   vec2 pixel = position * (1.0 / 16.0);\n"
+   "   gl_Position = vec4(pixel.x / viewport.x * 2.0 - 1.0, 1.0 - pixel.y / viewport.y * 2.0, 0.0, 1.0);\n"
+   "   v_color = color;\n"
+   "}\n";
+
+static const gpu_vertex_format debug_format = { sizeof(debug_vertex), 2, {
+   { 0, 2, GPU_ATTRIB_PIXEL, offsetof(debug_vertex, x) },
+   { 1, 4, GPU_ATTRIB_UNORM8, offsetof(debug_vertex, color) },
+} };
+
+static const char *debug_fragment_shader_src =
+   "#version 330 core\n"
+   "in vec4 v_color;\n"
+   "out vec4 frag_color;\n"
+   "void main() {\n"
+   "   frag_color = v_color;\n"
+   "}\n";
+
+bool debug_draw_init(debug_draw *dd) {
+   memset(dd, 0, sizeof(*dd));
+   dd->lines = (debug_vertex *)core_malloc(DEBUG_DRAW_LINE_VERTICES * sizeof(debug_vertex));
+   dd->fills = (debug_vertex *)core_malloc(DEBUG_DRAW_FILL_VERTICES * sizeof(debug_vertex));
+   if (!dd->lines || !dd->fills) {
+      debug_draw_deinit(dd);
+      return false;
+   }
+   return true;
+}
+
+void debug_draw_deinit(debug_draw *dd) {
+   core_free(dd->lines);
+   core_free(dd->fills);
+   memset(dd, 0, sizeof(*dd));
+}
+
+void debug_draw_reset(debug_draw *dd) {
+   atomic_store_i32(&dd->line_count, 0);
+   atomic_store_i32(&dd->fill_count, 0);
+   atomic_store_i32(&dd->dropped, 0);
+}
+
+// Claim n vertices of an array for a whole primitive, or none of them, so
+// concurrent recorders never leave a half-written primitive behind.
+// Returns the first index, or -1 (counted as dropped) when full.
+static int reserve(debug_draw *dd, atomic_i32 *count, int n, int capacity) {
+   int base;
+   do {
+      base = atomic_load_i32(count);
+      if (base + n > capacity) {
+         atomic_fetch_add_i32(&dd->dropped, 1);
+         return -1;
+      }
+   } while (!atomic_cas_i32(count, base, base + n));
+   return base;
+}
+
+static void put(debug_vertex *v, float x, float y, uint32_t color) {
+   v->x = gpu_pack_pixel(x);
+   v->y = gpu_pack_pixel(y);
+   v->color = color;
+}
+
+void debug_line(debug_draw *dd, float x0, float y0, float x1, float y1, uint32_t color) {
+   int i;
+   if (!dd->lines || (i = reserve(dd, &dd->line_count, 2, DEBUG_DRAW_LINE_VERTICES)) < 0)
+      return;
+   put(&dd->lines[i], x0, y0, color);
+   put(&dd->lines[i + 1], x1, y1, color);
+}
+
+void debug_rect(debug_draw *dd, float x, float y, float w, float h, uint32_t color) {
+   debug_vertex *v;
+   int i;
+   if (!dd->lines || (i = reserve(dd, &dd->line_count, 8, DEBUG_DRAW_LINE_VERTICES)) < 0)
+      return;
+   v = &dd->lines[i];
+   put(&v[0], x, y, color);
+   put(&v[1], x + w, y, color);
+   put(&v[2], x + w, y, color);
+   put(&v[3], x + w, y + h, color);
+   put(&v[4], x + w, y + h, color);
+   put(&v[5], x, y + h, color);
+   put(&v[6], x, y + h, color);
+   put(&v[7], x, y, color);
+}
+
+void debug_fill_rect(debug_draw *dd, float x, float y, float w, float h, uint32_t color) {
+   debug_vertex *v;
+   int i;
+   if (!dd->fills || (i = reserve(dd, &dd->fill_count, 6, DEBUG_DRAW_FILL_VERTICES)) < 0)
+      return;
+   v = &dd->fills[i];
+   put(&v[0], x, y, color);
+   put(&v[1], x + w, y, color);
+   put(&v[2], x, y + h, color);
+   put(&v[3], x + w, y, color);
+   put(&v[4], x + w, y + h, color);
+   put(&v[5], x, y + h, color);
+}
+
+void debug_circle(debug_draw *dd, float cx, float cy, float radius, uint32_t color) {
+   int segments = (int)ceilf(6.2831853f * fabsf(radius) / CIRCLE_SEGMENT_PIXELS);
+   float px = cx + radius, py = cy;
+   debug_vertex *v;
+   int i, s;
+   if (segments < CIRCLE_MIN_SEGMENTS)
+      segments = CIRCLE_MIN_SEGMENTS;
+   if (segments > CIRCLE_MAX_SEGMENTS)
+      segments = CIRCLE_MAX_SEGMENTS;
+   if (!dd->lines || (i = reserve(dd, &dd->line_count, segments * 2, DEBUG_DRAW_LINE_VERTICES)) < 0)
+      return;
+   v = &dd->lines[i];
+   for (s = 1; s <= segments; s++) {
+      float a = 6.2831853f * s / segments;
+      float x = cx + radius * cosf(a), y = cy + radius * sinf(a);
+      put(v++, px, py, color);
+      put(v++, x, y, color);
+      px = x;
+      py = y;
+   }
+}
+
+bool debug_draw_gl_init(core_t *core, debug_draw_renderer *r) {
+   memset(r, 0, sizeof(*r));
+   r->program = core_create_shader_program(core, debug_vertex_shader_src, debug_fragment_shader_src, "Debug draw");
+   if (!r->program)
+      return false;
+   r->viewport_loc = glGetUniformLocation(r->program, "viewport");
+
+   // Attribute pointers follow each flush's reservation in the stream
+   glGenVertexArrays(1, &r->vao);
+   if (!gpu_stream_init(&r->vertices, &core->gpu,
+         (DEBUG_DRAW_LINE_VERTICES + DEBUG_DRAW_FILL_VERTICES) * sizeof(debug_vertex))) {
+      debug_draw_gl_deinit(r);
+      return false;
+   }
+   return true;
+}
+
+void debug_draw_gl_deinit(debug_draw_renderer *r) {
+   if (r->vertices.buffer)
+      gpu_stream_deinit(&r->vertices);
+   if (r->vao)
+      glDeleteVertexArrays(1, &r->vao);
+   if (r->program)
+      glDeleteProgram(r->program);
+   memset(r, 0, sizeof(*r));
+}
+
+unsigned debug_draw_flush(debug_draw_renderer *r, const debug_draw *dd, float vp_width, float vp_height) {
+   int lines = dd->line_count, fills = dd->fill_count;
+   unsigned draws = 0;
+   debug_vertex *dst;
+   GLintptr offset;
+   if (!r->program || (!lines && !fills))
+      return 0;
+
+   // Outlines, then filled shapes, in one reservation
+   dst = (debug_vertex *)gpu_stream_map(&r->vertices, (lines + fills) * sizeof(debug_vertex), &offset);
+   if (!dst)
+      return 0;
+   memcpy(dst, dd->lines, lines * sizeof(debug_vertex));
+   memcpy(dst + lines, dd->fills, fills * sizeof(debug_vertex));
+   gpu_stream_unmap(&r->vertices);
+
+   glDisable(GL_DEPTH_TEST);
+   glEnable(GL_BLEND);
+   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+   glUseProgram(r->program);
+   glUniform2f(r->viewport_loc, vp_width, vp_height);
+   glBindVertexArray(r->vao);
+   glBindBuffer(GL_ARRAY_BUFFER, r->vertices.buffer);
+   gpu_vertex_format_apply(&debug_format, offset);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   // Fills first so outlines drawn around them stay visible
+   if (fills) {
+      glDrawArrays(GL_TRIANGLES, lines, fills);
+      draws++;
+   }
+   if (lines) {
+      glDrawArrays(GL_LINES, 0, lines);
+      draws++;
+   }
+   glBindVertexArray(0);
+   glUseProgram(0);
+   return draws;
+}
+
+#endif // CORE_DEBUG_DRAW
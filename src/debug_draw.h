@@ -0,0 +1,116 @@
+#ifndef DEBUG_DRAW_H
+#define DEBUG_DRAW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+#include <retro_inline.h>
+#include "atomics.h"
+#include "gpu.h"
+
+// Debug draw is compiled in unless NDEBUG is defined (CMake's Release and
+// MinSizeRel configurations); define CORE_DEBUG_DRAW to 0 or 1 to force it
+#ifndef CORE_DEBUG_DRAW
+#ifdef NDEBUG
+#define CORE_DEBUG_DRAW 0
+#else
+#define CORE_DEBUG_DRAW 1
+#endif
+#endif
+
+#define DEBUG_DRAW_LINE_VERTICES 32768 // Per frame, two per line
+#define DEBUG_DRAW_FILL_VERTICES 6144  // Per frame, six per filled rect
+
+// Immediate-mode lines, rects and circles for diagnostics, in pixels like
+// every other draw in the core. Primitives are recorded into fixed vertex
+// arrays in the frame's render list from any thread (simulation, its jobs)
+// and flushed after the frame's commands: one draw call for outlines, one
+// for filled shapes, however many were recorded. Recording never
+// allocates; what doesn't fit is dropped and counted.
+//
+// With CORE_DEBUG_DRAW 0 the recording calls expand to nothing (their
+// arguments aren't evaluated) and the rest are empty stubs.
+
+// 8 bytes: 12.4 fixed-point pixels (GPU_ATTRIB_PIXEL), so points beyond
+// 2048 pixels off the top-left corner are clamped
+typedef struct debug_vertex {
+   int16_t x, y;
+   uint32_t color; // RGBA8
+} debug_vertex;
+
+typedef struct debug_draw {
+#if CORE_DEBUG_DRAW
+   debug_vertex *lines; // DEBUG_DRAW_LINE_VERTICES
+   debug_vertex *fills; // DEBUG_DRAW_FILL_VERTICES
+   atomic_i32 line_count, fill_count;
+   atomic_i32 dropped; // Primitives that didn't fit this frame
+#else
+   int unused;
+#endif
+} debug_draw;
+
+// Program and stream buffer; instance thread only
+typedef struct debug_draw_renderer {
+   GLuint program, vao;
+   gpu_stream vertices;
+   GLint viewport_loc;
+} debug_draw_renderer;
+
+struct core;
+
+#if CORE_DEBUG_DRAW
+
+bool debug_draw_init(debug_draw *dd);
+void debug_draw_deinit(debug_draw *dd);
+// Forget the previous frame's primitives
+void debug_draw_reset(debug_draw *dd);
+
+// RGBA8 colors, as everywhere else
+void debug_line(debug_draw *dd, float x0, float y0, float x1, float y1, uint32_t color);
+void debug_rect(debug_draw *dd, float x, float y, float w, float h, uint32_t color);
+void debug_fill_rect(debug_draw *dd, float x, float y, float w, float h, uint32_t color);
+// Outline with enough segments to look round at its radius
+void debug_circle(debug_draw *dd, float cx, float cy, float radius, uint32_t color);
+
+// Primitives dropped since the last reset; read once recording is done
+static INLINE unsigned debug_draw_dropped(const debug_draw *dd) {
+   return (unsigned)dd->dropped;
+}
+
+// Needs a current GL context
+bool debug_draw_gl_init(struct core *core, debug_draw_renderer *r);
+void debug_draw_gl_deinit(debug_draw_renderer *r);
+// Draw everything dd recorded over the bound framebuffer, without depth
+// testing; returns the draw calls issued (0 to 2)
+unsigned debug_draw_flush(debug_draw_renderer *r, const debug_draw *dd, float vp_width, float vp_height);
+
+#else
+
+static INLINE bool debug_draw_init(debug_draw *dd) { (void)dd; return true; }
+static INLINE void debug_draw_deinit(debug_draw *dd) { (void)dd; }
+static INLINE void debug_draw_reset(debug_draw *dd) { (void)dd; }
+static INLINE unsigned debug_draw_dropped(const debug_draw *dd) { (void)dd; return 0; }
+
+#define debug_line(dd, x0, y0, x1, y1, color) ((void)0)
+#define debug_rect(dd, x, y, w, h, color) ((void)0)
+#define debug_fill_rect(dd, x, y, w, h, color) ((void)0)
+#define debug_circle(dd, cx, cy, radius, color) ((void)0)
+
+static INLINE bool debug_draw_gl_init(struct core *core, debug_draw_renderer *r) {
+   (void)core;
+   (void)r;
+   return true;
+}
+static INLINE void debug_draw_gl_deinit(debug_draw_renderer *r) { (void)r; }
+static INLINE unsigned debug_draw_flush(debug_draw_renderer *r, const debug_draw *dd,
+      float vp_width, float vp_height) {
+   (void)r;
+   (void)dd;
+   (void)vp_width;
+   (void)vp_height;
+   return 0;
+}
+
+#endif // CORE_DEBUG_DRAW
+
+#endif // DEBUG_DRAW_H
@@ -0,0 +1,234 @@
+#include "entities.h"
+#include "alloc.h"
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENTITIES_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ENTITIES_NEON
+#endif
+
+#define TWO_PI 6.28318530718f
+#define ENTITY_UPDATE_GRAIN 4096 // Entities per job
+
+// Sine approximation (parabola + one refinement step, max error ~0.001),
+// shared by the scalar and SIMD paths so they agree. x must be >= 0.
+#define SIN_B (4.0f / 3.14159265359f)
+#define SIN_C (-4.0f / (3.14159265359f * 3.14159265359f))
+#define SIN_P 0.225f
+
+static float fast_sinf(float x) {
+   // Reduce to [-pi, pi)
+   x -= TWO_PI * (float)(int)(x * (1.0f / TWO_PI) + 0.5f);
+   float y = SIN_B * x + SIN_C * x * fabsf(x);
+   return SIN_P * (y * fabsf(y) - y) + y;
+}
+
+bool entity_store_init(entity_store *store, unsigned capacity, float bounds_w, float bounds_h) {
+   memset(store, 0, sizeof(*store));
+   capacity = (capacity + 3) & ~3u;
+   if (capacity == 0)
+      capacity = 4;
+
+   // Ten 4-byte streams in one block; each stream starts 16-byte aligned
+   // because capacity is a multiple of 4 (malloc alignment is >= 16 on
+   // the 64-bit targets we ship)
+   float *block = (float *)core_malloc((size_t)capacity * 10 * sizeof(float));
+   if (!block)
+      return false;
+   store->block = block;
+   store->capacity = capacity;
+   store->x = block;
+   store->y = block + capacity;
+   store->vx = block + capacity * 2;
+   store->vy = block + capacity * 3;
+   store->base_w = block + capacity * 4;
+   store->base_h = block + capacity * 5;
+   store->w = block + capacity * 6;
+   store->h = block + capacity * 7;
+   store->phase = block + capacity * 8;
+   store->color = (uint32_t *)(block + capacity * 9);
+   store->bounds_w = bounds_w;
+   store->bounds_h = bounds_h;
+   return true;
+}
+
+void entity_store_deinit(entity_store *store) {
+   core_free(store->block);
+   memset(store, 0, sizeof(*store));
+}
+
+int entity_spawn(entity_store *store, float x, float y, float vx, float vy,
+      float w, float h, float phase, uint32_t color) {
+   if (store->count >= store->capacity)
+      return -1;
+   unsigned i = store->count++;
+   store->x[i] = x;
+   store->y[i] = y;
+   store->vx[i] = vx;
+   store->vy[i] = vy;
+   store->base_w[i] = store->w[i] = w;
+   store->base_h[i] = store->h[i] = h;
+   // Keep phases in [0, 2pi): the update kernels rely on non-negative angles
+   phase = fmodf(phase, TWO_PI);
+   store->phase[i] = phase < 0.0f ? phase + TWO_PI : phase;
+   store->color[i] = color;
+   return (int)i;
+}
+
+static uint32_t xorshift32(uint32_t *state) {
+   uint32_t x = *state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   return *state = x;
+}
+
+static float random_unit(uint32_t *state) {
+   return (xorshift32(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+void entity_spawn_random(entity_store *store, unsigned count, uint32_t seed) {
+   uint32_t state = seed ? seed : 0x12345678u;
+   unsigned i;
+   for (i = 0; i < count; i++) {
+      float size = 2.0f + random_unit(&state) * 10.0f;
+      float angle = random_unit(&state) * TWO_PI;
+      float speed = 20.0f + random_unit(&state) * 100.0f;
+      uint32_t r = 64 + (xorshift32(&state) & 191);
+      uint32_t g = 64 + (xorshift32(&state) & 191);
+      uint32_t b = 64 + (xorshift32(&state) & 191);
+      if (entity_spawn(store,
+            random_unit(&state) * store->bounds_w, random_unit(&state) * store->bounds_h,
+            cosf(angle) * speed, sinf(angle) * speed,
+            size, size, random_unit(&state) * TWO_PI,
+            r | (g << 8) | (b << 16) | 0xff000000u) < 0)
+         break;
+   }
+}
+
+typedef struct entity_update_args {
+   entity_store *store;
+   float dt;
+   float angle; // 2 * time, reduced to [0, 2pi)
+} entity_update_args;
+
+static void update_scalar(const entity_update_args *args, unsigned begin, unsigned end) {
+   entity_store *s = args->store;
+   unsigned i;
+   for (i = begin; i < end; i++) {
+      if ((s->x[i] < 0.0f && s->vx[i] < 0.0f) || (s->x[i] > s->bounds_w && s->vx[i] > 0.0f))
+         s->vx[i] = -s->vx[i];
+      if ((s->y[i] < 0.0f && s->vy[i] < 0.0f) || (s->y[i] > s->bounds_h && s->vy[i] > 0.0f))
+         s->vy[i] = -s->vy[i];
+      s->x[i] += s->vx[i] * args->dt;
+      s->y[i] += s->vy[i] * args->dt;
+      float scale = 0.8f + 0.2f * fast_sinf(args->angle + s->phase[i]);
+      s->w[i] = s->base_w[i] * scale;
+      s->h[i] = s->base_h[i] * scale;
+   }
+}
+
+#if defined(ENTITIES_SSE2)
+static __m128 sin_sse2(__m128 x) {
+   const __m128 sign_mask = _mm_set1_ps(-0.0f);
+   __m128 k = _mm_cvtepi32_ps(_mm_cvttps_epi32(
+         _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.0f / TWO_PI)), _mm_set1_ps(0.5f))));
+   x = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(TWO_PI)));
+   __m128 y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_B), x),
+         _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(SIN_C), x), _mm_andnot_ps(sign_mask, x)));
+   __m128 y_abs_y = _mm_mul_ps(y, _mm_andnot_ps(sign_mask, y));
+   return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_P), _mm_sub_ps(y_abs_y, y)), y);
+}
+
+// Flip velocity lanes heading out of [0, bound]
+static __m128 bounce_sse2(__m128 p, __m128 v, __m128 bound) {
+   const __m128 zero = _mm_setzero_ps();
+   __m128 out_low = _mm_and_ps(_mm_cmplt_ps(p, zero), _mm_cmplt_ps(v, zero));
+   __m128 out_high = _mm_and_ps(_mm_cmpgt_ps(p, bound), _mm_cmpgt_ps(v, zero));
+   __m128 flip = _mm_and_ps(_mm_or_ps(out_low, out_high), _mm_set1_ps(-0.0f));
+   return _mm_xor_ps(v, flip);
+}
+
+static void update_range(const entity_update_args *args, unsigned begin, unsigned end) {
+   entity_store *s = args->store;
+   const __m128 dt = _mm_set1_ps(args->dt);
+   const __m128 angle = _mm_set1_ps(args->angle);
+   const __m128 bounds_w = _mm_set1_ps(s->bounds_w);
+   const __m128 bounds_h = _mm_set1_ps(s->bounds_h);
+   unsigned i = begin;
+   for (; i + 4 <= end; i += 4) {
+      __m128 x = _mm_loadu_ps(s->x + i), y = _mm_loadu_ps(s->y + i);
+      __m128 vx = bounce_sse2(x, _mm_loadu_ps(s->vx + i), bounds_w);
+      __m128 vy = bounce_sse2(y, _mm_loadu_ps(s->vy + i), bounds_h);
+      _mm_storeu_ps(s->vx + i, vx);
+      _mm_storeu_ps(s->vy + i, vy);
+      _mm_storeu_ps(s->x + i, _mm_add_ps(x, _mm_mul_ps(vx, dt)));
+      _mm_storeu_ps(s->y + i, _mm_add_ps(y, _mm_mul_ps(vy, dt)));
+
+      __m128 scale = _mm_add_ps(_mm_set1_ps(0.8f), _mm_mul_ps(_mm_set1_ps(0.2f),
+            sin_sse2(_mm_add_ps(angle, _mm_loadu_ps(s->phase + i)))));
+      _mm_storeu_ps(s->w + i, _mm_mul_ps(_mm_loadu_ps(s->base_w + i), scale));
+      _mm_storeu_ps(s->h + i, _mm_mul_ps(_mm_loadu_ps(s->base_h + i), scale));
+   }
+   update_scalar(args, i, end);
+}
+#elif defined(ENTITIES_NEON)
+static float32x4_t sin_neon(float32x4_t x) {
+   float32x4_t k = vcvtq_f32_s32(vcvtq_s32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), x, 1.0f / TWO_PI)));
+   x = vmlsq_n_f32(x, k, TWO_PI);
+   float32x4_t y = vmlaq_f32(vmulq_n_f32(x, SIN_B), vmulq_n_f32(x, SIN_C), vabsq_f32(x));
+   float32x4_t y_abs_y = vmulq_f32(y, vabsq_f32(y));
+   return vmlaq_n_f32(y, vsubq_f32(y_abs_y, y), SIN_P);
+}
+
+static float32x4_t bounce_neon(float32x4_t p, float32x4_t v, float32x4_t bound) {
+   const float32x4_t zero = vdupq_n_f32(0.0f);
+   uint32x4_t out_low = vandq_u32(vcltq_f32(p, zero), vcltq_f32(v, zero));
+   uint32x4_t out_high = vandq_u32(vcgtq_f32(p, bound), vcgtq_f32(v, zero));
+   uint32x4_t flip = vandq_u32(vorrq_u32(out_low, out_high), vdupq_n_u32(0x80000000u));
+   return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(v), flip));
+}
+
+static void update_range(const entity_update_args *args, unsigned begin, unsigned end) {
+   entity_store *s = args->store;
+   const float32x4_t angle = vdupq_n_f32(args->angle);
+   const float32x4_t bounds_w = vdupq_n_f32(s->bounds_w);
+   const float32x4_t bounds_h = vdupq_n_f32(s->bounds_h);
+   unsigned i = begin;
+   for (; i + 4 <= end; i += 4) {
+      float32x4_t x = vld1q_f32(s->x + i), y = vld1q_f32(s->y + i);
+      float32x4_t vx = bounce_neon(x, vld1q_f32(s->vx + i), bounds_w);
+      float32x4_t vy = bounce_neon(y, vld1q_f32(s->vy + i), bounds_h);
+      vst1q_f32(s->vx + i, vx);
+      vst1q_f32(s->vy + i, vy);
+      vst1q_f32(s->x + i, vmlaq_n_f32(x, vx, args->dt));
+      vst1q_f32(s->y + i, vmlaq_n_f32(y, vy, args->dt));
+
+      float32x4_t scale = vmlaq_n_f32(vdupq_n_f32(0.8f),
+            sin_neon(vaddq_f32(angle, vld1q_f32(s->phase + i))), 0.2f);
+      vst1q_f32(s->w + i, vmulq_f32(vld1q_f32(s->base_w + i), scale));
+      vst1q_f32(s->h + i, vmulq_f32(vld1q_f32(s->base_h + i), scale));
+   }
+   update_scalar(args, i, end);
+}
+#else
+static void update_range(const entity_update_args *args, unsigned begin, unsigned end) {
+   update_scalar(args, begin, end);
+}
+#endif
+
+static void update_job(void *data, unsigned begin, unsigned end) {
+   update_range((const entity_update_args *)data, begin, end);
+}
+
+void entity_update(entity_store *store, float dt, float time, job_system_t *js) {
+   entity_update_args args;
+   args.store = store;
+   args.dt = dt;
+   args.angle = (float)fmod(2.0 * (double)time, (double)TWO_PI);
+   job_parallel_for(js, update_job, &args, store->count, ENTITY_UPDATE_GRAIN);
+}
@@ -0,0 +1,46 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "jobs.h"
+
+// Structure-of-arrays entity storage. Every component is its own tightly
+// packed array, so update kernels stream through exactly the data they
+// touch and process four entities per SIMD instruction. The arrays use
+// the quad_streams layout: x/y are the quad center, w/h the animated size,
+// color packed RGBA8. Visible entities are copied into the render list,
+// recorded as one stream command and drawn by quad_batch_submit().
+typedef struct entity_store {
+   unsigned count;
+   unsigned capacity; // Multiple of 4
+
+   // Components
+   float *x, *y;           // Position (quad center, pixels)
+   float *vx, *vy;         // Velocity (pixels per second)
+   float *base_w, *base_h; // Rest size
+   float *w, *h;           // Animated size, written by entity_update
+   float *phase;           // Animation phase offset (radians)
+   uint32_t *color;        // RGBA8
+
+   // World bounds entities bounce inside
+   float bounds_w, bounds_h;
+
+   void *block; // Single allocation backing every array
+} entity_store;
+
+bool entity_store_init(entity_store *store, unsigned capacity, float bounds_w, float bounds_h);
+void entity_store_deinit(entity_store *store);
+
+// Append an entity; returns its index or -1 when full
+int entity_spawn(entity_store *store, float x, float y, float vx, float vy,
+      float w, float h, float phase, uint32_t color);
+
+// Fill the store with count randomly placed, moving, pulsing entities
+void entity_spawn_random(entity_store *store, unsigned count, uint32_t seed);
+
+// Integrate positions (bouncing at the bounds) and animate sizes with the
+// same pulse as the main quad. Splits across the job system when js is set.
+void entity_update(entity_store *store, float dt, float time, job_system_t *js);
+
+#endif // ENTITIES_H
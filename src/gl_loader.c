@@ -0,0 +1,165 @@
+#include "gl_loader.h"
+#include <string.h>
+
+#define GL_LOADER_STRING_MAX 256
+
+// Slots of a function table, in list order
+#define FUNCTION_INDEX(type, name) INDEX_##name,
+enum {
+   GL_LOADER_FUNCTIONS(FUNCTION_INDEX)
+   GL_LOADER_DESKTOP_FUNCTIONS(FUNCTION_INDEX)
+   GL_LOADER_OPTIONAL_FUNCTIONS(FUNCTION_INDEX)
+   FUNCTION_COUNT
+};
+
+#define COUNT_FUNCTION(type, name) +1
+enum { DESKTOP_FUNCTION_COUNT = 0 GL_LOADER_DESKTOP_FUNCTIONS(COUNT_FUNCTION) };
+
+// A resolved table, built off to the side and published to glad's globals
+// only once complete
+typedef struct gl_table {
+   bool gles;
+   retro_proc_address_t functions[FUNCTION_COUNT];
+   int flags[2][32]; // Version and extension flags, in the tables' order
+} gl_table;
+
+// The last table resolved, and what it was resolved for
+static struct {
+   bool valid;
+   retro_hw_get_proc_address_t get_proc_address;
+   char renderer[GL_LOADER_STRING_MAX], version[GL_LOADER_STRING_MAX];
+   gl_table table;
+} cache;
+
+static struct {
+   int *flag;
+   int major, minor;
+} const versions[] = {
+   { &GLAD_GL_VERSION_1_0, 1, 0 }, { &GLAD_GL_VERSION_1_1, 1, 1 }, { &GLAD_GL_VERSION_1_2, 1, 2 },
+   { &GLAD_GL_VERSION_1_3, 1, 3 }, { &GLAD_GL_VERSION_1_4, 1, 4 }, { &GLAD_GL_VERSION_1_5, 1, 5 },
+   { &GLAD_GL_VERSION_2_0, 2, 0 }, { &GLAD_GL_VERSION_2_1, 2, 1 }, { &GLAD_GL_VERSION_3_0, 3, 0 },
+   { &GLAD_GL_VERSION_3_1, 3, 1 }, { &GLAD_GL_VERSION_3_2, 3, 2 }, { &GLAD_GL_VERSION_3_3, 3, 3 },
+   { &GLAD_GL_VERSION_4_0, 4, 0 }, { &GLAD_GL_VERSION_4_1, 4, 1 }, { &GLAD_GL_VERSION_4_2, 4, 2 },
+   { &GLAD_GL_VERSION_4_3, 4, 3 }, { &GLAD_GL_VERSION_4_4, 4, 4 }, { &GLAD_GL_VERSION_4_5, 4, 5 },
+   { &GLAD_GL_VERSION_4_6, 4, 6 },
+};
+
+// Extensions gpu_caps_detect() consults
+static struct {
+   int *flag;
+   const char *name;
+} const extensions[] = {
+   { &GLAD_GL_ARB_direct_state_access, "GL_ARB_direct_state_access" },
+   { &GLAD_GL_ARB_buffer_storage, "GL_ARB_buffer_storage" },
+   { &GLAD_GL_ARB_multi_draw_indirect, "GL_ARB_multi_draw_indirect" },
+   { &GLAD_GL_ARB_invalidate_subdata, "GL_ARB_invalidate_subdata" },
+};
+
+#define VERSION_COUNT (sizeof(versions) / sizeof(versions[0]))
+#define EXTENSION_COUNT (sizeof(extensions) / sizeof(extensions[0]))
+
+static bool copy_string(char *dst, const GLubyte *src) {
+   size_t len = src ? strlen((const char *)src) : 0;
+   if (!src || len >= GL_LOADER_STRING_MAX)
+      return false;
+   memcpy(dst, src, len + 1);
+   return true;
+}
+
+// Version and extension flags of the current desktop context, read
+// through the table's own entry points
+static void detect_flags(gl_table *table) {
+   PFNGLGETINTEGERVPROC get_integerv = (PFNGLGETINTEGERVPROC)table->functions[INDEX_glGetIntegerv];
+   PFNGLGETSTRINGIPROC get_stringi = (PFNGLGETSTRINGIPROC)table->functions[INDEX_glGetStringi];
+   GLint major = 0, minor = 0, count = 0, i;
+   unsigned j;
+   get_integerv(GL_MAJOR_VERSION, &major);
+   get_integerv(GL_MINOR_VERSION, &minor);
+   for (j = 0; j < VERSION_COUNT; j++)
+      table->flags[0][j] = major > versions[j].major || (major == versions[j].major && minor >= versions[j].minor);
+   get_integerv(GL_NUM_EXTENSIONS, &count);
+   for (j = 0; j < EXTENSION_COUNT; j++)
+      table->flags[1][j] = 0;
+   for (i = 0; i < count; i++) {
+      const char *name = (const char *)get_stringi(GL_EXTENSIONS, (GLuint)i);
+      for (j = 0; name && j < EXTENSION_COUNT; j++)
+         if (!strcmp(name, extensions[j].name))
+            table->flags[1][j] = 1;
+   }
+}
+
+// Copy a complete table into glad's globals. Other instances may be
+// drawing through them on other threads: each pointer is stored once,
+// with the same value if their context matches. A GLES table leaves the
+// desktop-only functions and the desktop version and extension flags as
+// they are; nothing reads them on GLES, and a desktop context may.
+static void publish(const gl_table *table) {
+   unsigned i = 0;
+#define PUBLISH_FUNCTION(type, name) name = (type)table->functions[i++];
+#define SKIP_FUNCTION(type, name) i++;
+   GL_LOADER_FUNCTIONS(PUBLISH_FUNCTION)
+   if (table->gles) {
+      GL_LOADER_DESKTOP_FUNCTIONS(SKIP_FUNCTION)
+   } else {
+      GL_LOADER_DESKTOP_FUNCTIONS(PUBLISH_FUNCTION)
+   }
+   GL_LOADER_OPTIONAL_FUNCTIONS(PUBLISH_FUNCTION)
+   if (table->gles)
+      return;
+   for (i = 0; i < VERSION_COUNT; i++)
+      *versions[i].flag = table->flags[0][i];
+   for (i = 0; i < EXTENSION_COUNT; i++)
+      *extensions[i].flag = table->flags[1][i];
+}
+
+bool gl_loader_load(retro_hw_get_proc_address_t get_proc_address, bool gles, gl_loader_result *result) {
+   char renderer[GL_LOADER_STRING_MAX], version[GL_LOADER_STRING_MAX];
+   PFNGLGETSTRINGPROC get_string;
+   gl_table table;
+   bool complete = true;
+   unsigned i = 0;
+
+   result->lookups = 1;
+   result->cached = false;
+   get_string = (PFNGLGETSTRINGPROC)get_proc_address("glGetString");
+   if (!get_string || !copy_string(renderer, get_string(GL_RENDERER)) ||
+         !copy_string(version, get_string(GL_VERSION)))
+      return false;
+
+   if (cache.valid && cache.get_proc_address == get_proc_address && cache.table.gles == gles &&
+         !strcmp(cache.renderer, renderer) && !strcmp(cache.version, version)) {
+      publish(&cache.table);
+      result->cached = true;
+      return true;
+   }
+
+   // One pass over the lists into a local table; glad's globals are only
+   // touched if the baseline is complete
+   memset(&table, 0, sizeof(table));
+   table.gles = gles;
+#define RESOLVE_FUNCTION(type, name) \
+   table.functions[i] = get_proc_address(#name); \
+   complete = complete && table.functions[i++];
+#define RESOLVE_OPTIONAL_FUNCTION(type, name) \
+   table.functions[i++] = get_proc_address(#name);
+   GL_LOADER_FUNCTIONS(RESOLVE_FUNCTION)
+   if (gles) {
+      GL_LOADER_DESKTOP_FUNCTIONS(SKIP_FUNCTION)
+   } else {
+      GL_LOADER_DESKTOP_FUNCTIONS(RESOLVE_FUNCTION)
+   }
+   GL_LOADER_OPTIONAL_FUNCTIONS(RESOLVE_OPTIONAL_FUNCTION)
+   result->lookups += FUNCTION_COUNT - (gles ? DESKTOP_FUNCTION_COUNT : 0);
+   if (!complete)
+      return false;
+   if (!gles)
+      detect_flags(&table);
+
+   publish(&table);
+   cache.table = table;
+   cache.get_proc_address = get_proc_address;
+   memcpy(cache.renderer, renderer, sizeof(renderer));
+   memcpy(cache.version, version, sizeof(version));
+   cache.valid = true;
+   return true;
+}
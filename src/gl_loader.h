@@ -0,0 +1,141 @@
+#ifndef GL_LOADER_H
+#define GL_LOADER_H
+
+#include <stdbool.h>
+#include <libretro.h>
+#include <glad/glad.h>
+
+// GL entry points the core calls, and only those, generated from the
+// sources with
+//   grep -ohw 'gl[A-Z][A-Za-z0-9]*' $(ls src/*.[ch] | grep -v main.c) | sort -u
+// and split by the version that made each core. Regenerate after using a
+// new GL function: a call missing here goes through a NULL pointer.
+
+// Core in GL 3.3 and GLES 3.0: all must resolve
+#define GL_LOADER_FUNCTIONS(X) \
+   X(PFNGLACTIVETEXTUREPROC, glActiveTexture) \
+   X(PFNGLATTACHSHADERPROC, glAttachShader) \
+   X(PFNGLBEGINQUERYPROC, glBeginQuery) \
+   X(PFNGLBEGINTRANSFORMFEEDBACKPROC, glBeginTransformFeedback) \
+   X(PFNGLBINDBUFFERPROC, glBindBuffer) \
+   X(PFNGLBINDBUFFERBASEPROC, glBindBufferBase) \
+   X(PFNGLBINDFRAMEBUFFERPROC, glBindFramebuffer) \
+   X(PFNGLBINDRENDERBUFFERPROC, glBindRenderbuffer) \
+   X(PFNGLBINDTEXTUREPROC, glBindTexture) \
+   X(PFNGLBINDVERTEXARRAYPROC, glBindVertexArray) \
+   X(PFNGLBLENDFUNCPROC, glBlendFunc) \
+   X(PFNGLBUFFERDATAPROC, glBufferData) \
+   X(PFNGLBUFFERSUBDATAPROC, glBufferSubData) \
+   X(PFNGLCHECKFRAMEBUFFERSTATUSPROC, glCheckFramebufferStatus) \
+   X(PFNGLCLEARPROC, glClear) \
+   X(PFNGLCLEARCOLORPROC, glClearColor) \
+   X(PFNGLCLIENTWAITSYNCPROC, glClientWaitSync) \
+   X(PFNGLCOMPILESHADERPROC, glCompileShader) \
+   X(PFNGLCOPYBUFFERSUBDATAPROC, glCopyBufferSubData) \
+   X(PFNGLCREATEPROGRAMPROC, glCreateProgram) \
+   X(PFNGLCREATESHADERPROC, glCreateShader) \
+   X(PFNGLDELETEBUFFERSPROC, glDeleteBuffers) \
+   X(PFNGLDELETEFRAMEBUFFERSPROC, glDeleteFramebuffers) \
+   X(PFNGLDELETEPROGRAMPROC, glDeleteProgram) \
+   X(PFNGLDELETEQUERIESPROC, glDeleteQueries) \
+   X(PFNGLDELETERENDERBUFFERSPROC, glDeleteRenderbuffers) \
+   X(PFNGLDELETESHADERPROC, glDeleteShader) \
+   X(PFNGLDELETESYNCPROC, glDeleteSync) \
+   X(PFNGLDELETETEXTURESPROC, glDeleteTextures) \
+   X(PFNGLDELETEVERTEXARRAYSPROC, glDeleteVertexArrays) \
+   X(PFNGLDEPTHFUNCPROC, glDepthFunc) \
+   X(PFNGLDEPTHMASKPROC, glDepthMask) \
+   X(PFNGLDISABLEPROC, glDisable) \
+   X(PFNGLDISABLEVERTEXATTRIBARRAYPROC, glDisableVertexAttribArray) \
+   X(PFNGLDRAWARRAYSPROC, glDrawArrays) \
+   X(PFNGLDRAWARRAYSINSTANCEDPROC, glDrawArraysInstanced) \
+   X(PFNGLDRAWBUFFERSPROC, glDrawBuffers) \
+   X(PFNGLENABLEPROC, glEnable) \
+   X(PFNGLENABLEVERTEXATTRIBARRAYPROC, glEnableVertexAttribArray) \
+   X(PFNGLENDQUERYPROC, glEndQuery) \
+   X(PFNGLENDTRANSFORMFEEDBACKPROC, glEndTransformFeedback) \
+   X(PFNGLFENCESYNCPROC, glFenceSync) \
+   X(PFNGLFRAMEBUFFERRENDERBUFFERPROC, glFramebufferRenderbuffer) \
+   X(PFNGLFRAMEBUFFERTEXTURE2DPROC, glFramebufferTexture2D) \
+   X(PFNGLGENBUFFERSPROC, glGenBuffers) \
+   X(PFNGLGENFRAMEBUFFERSPROC, glGenFramebuffers) \
+   X(PFNGLGENQUERIESPROC, glGenQueries) \
+   X(PFNGLGENRENDERBUFFERSPROC, glGenRenderbuffers) \
+   X(PFNGLGENTEXTURESPROC, glGenTextures) \
+   X(PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays) \
+   X(PFNGLGETERRORPROC, glGetError) \
+   X(PFNGLGETINTEGERVPROC, glGetIntegerv) \
+   X(PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog) \
+   X(PFNGLGETPROGRAMIVPROC, glGetProgramiv) \
+   X(PFNGLGETQUERYOBJECTUIVPROC, glGetQueryObjectuiv) \
+   X(PFNGLGETSHADERINFOLOGPROC, glGetShaderInfoLog) \
+   X(PFNGLGETSHADERIVPROC, glGetShaderiv) \
+   X(PFNGLGETSTRINGPROC, glGetString) \
+   X(PFNGLGETSTRINGIPROC, glGetStringi) \
+   X(PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation) \
+   X(PFNGLISBUFFERPROC, glIsBuffer) \
+   X(PFNGLISPROGRAMPROC, glIsProgram) \
+   X(PFNGLISVERTEXARRAYPROC, glIsVertexArray) \
+   X(PFNGLLINKPROGRAMPROC, glLinkProgram) \
+   X(PFNGLMAPBUFFERRANGEPROC, glMapBufferRange) \
+   X(PFNGLPIXELSTOREIPROC, glPixelStorei) \
+   X(PFNGLREADBUFFERPROC, glReadBuffer) \
+   X(PFNGLREADPIXELSPROC, glReadPixels) \
+   X(PFNGLRENDERBUFFERSTORAGEPROC, glRenderbufferStorage) \
+   X(PFNGLSHADERSOURCEPROC, glShaderSource) \
+   X(PFNGLTEXIMAGE2DPROC, glTexImage2D) \
+   X(PFNGLTEXPARAMETERIPROC, glTexParameteri) \
+   X(PFNGLTEXSUBIMAGE2DPROC, glTexSubImage2D) \
+   X(PFNGLTRANSFORMFEEDBACKVARYINGSPROC, glTransformFeedbackVaryings) \
+   X(PFNGLUNIFORM1FPROC, glUniform1f) \
+   X(PFNGLUNIFORM1IPROC, glUniform1i) \
+   X(PFNGLUNIFORM2FPROC, glUniform2f) \
+   X(PFNGLUNIFORM3FPROC, glUniform3f) \
+   X(PFNGLUNIFORM4FPROC, glUniform4f) \
+   X(PFNGLUNMAPBUFFERPROC, glUnmapBuffer) \
+   X(PFNGLUSEPROGRAMPROC, glUseProgram) \
+   X(PFNGLVERTEXATTRIB1FPROC, glVertexAttrib1f) \
+   X(PFNGLVERTEXATTRIB4FPROC, glVertexAttrib4f) \
+   X(PFNGLVERTEXATTRIBDIVISORPROC, glVertexAttribDivisor) \
+   X(PFNGLVERTEXATTRIBPOINTERPROC, glVertexAttribPointer) \
+   X(PFNGLVIEWPORTPROC, glViewport)
+
+// Core in GL 3.3 but not in GLES 3.0: must resolve on desktop GL, not
+// loaded on GLES, where the callers don't run
+#define GL_LOADER_DESKTOP_FUNCTIONS(X) \
+   X(PFNGLGETQUERYOBJECTUI64VPROC, glGetQueryObjectui64v)
+
+// Above 3.3: may stay NULL; gpu_caps_detect() only enables a feature
+// whose functions resolved
+#define GL_LOADER_OPTIONAL_FUNCTIONS(X) \
+   X(PFNGLBUFFERSTORAGEPROC, glBufferStorage) \
+   X(PFNGLCREATETEXTURESPROC, glCreateTextures) \
+   X(PFNGLINVALIDATEFRAMEBUFFERPROC, glInvalidateFramebuffer) \
+   X(PFNGLMULTIDRAWARRAYSINDIRECTPROC, glMultiDrawArraysIndirect) \
+   X(PFNGLNAMEDBUFFERSUBDATAPROC, glNamedBufferSubData) \
+   X(PFNGLTEXTUREPARAMETERIPROC, glTextureParameteri) \
+   X(PFNGLTEXTURESTORAGE2DPROC, glTextureStorage2D) \
+   X(PFNGLTEXTURESUBIMAGE2DPROC, glTextureSubImage2D)
+
+typedef struct gl_loader_result {
+   unsigned lookups; // get_proc_address calls this load made
+   bool cached;      // Same renderer and version as last time: table reused
+} gl_loader_result;
+
+// Fill glad's function pointers for the lists above, plus the version and
+// extension flags the core reads (GLAD_GL_VERSION_*, the ARB extensions
+// gpu_caps_detect() checks), in place of gladLoadGLLoader(), which looks
+// up every entry point glad knows. glad is generated for desktop GL, but
+// GLES 3.0 functions share its names and prototypes; for a GLES context
+// (gles) the desktop-only functions and the desktop version and extension
+// flags are left as they are. Everything is resolved into a local table
+// and copied to glad's globals only if the baseline is complete, so a
+// failed load leaves the pointers other instances draw through alone. The
+// table is kept for the process: when a context reset finds the same
+// get_proc_address, GL_RENDERER and GL_VERSION, it is restored without
+// resolving anything but glGetString. Needs a current context; not
+// thread-safe (glad's pointers are process-wide, so callers serialize
+// loads).
+bool gl_loader_load(retro_hw_get_proc_address_t get_proc_address, bool gles, gl_loader_result *result);
+
+#endif // GL_LOADER_H
@@ -0,0 +1,198 @@
+#include "gpu.h"
+#include <string.h>
+
+#define FENCE_TIMEOUT_NS 1000000000ull // Per wait; a GPU this slow is hung
+
+void gpu_caps_detect(gpu_caps *caps, bool gles, bool force_baseline) {
+   int version;
+   memset(caps, 0, sizeof(*caps));
+   glGetIntegerv(GL_MAJOR_VERSION, &caps->major);
+   glGetIntegerv(GL_MINOR_VERSION, &caps->minor);
+   caps->gles = gles;
+   if (gles) {
+      caps->tier = GPU_TIER_GLES3;
+      caps->invalidate_subdata = !force_baseline && glInvalidateFramebuffer;
+      return;
+   }
+   if (force_baseline)
+      return;
+   version = caps->major * 10 + caps->minor;
+   caps->tier = version >= 45 ? GPU_TIER_GL45 : version >= 43 ? GPU_TIER_GL43 : GPU_TIER_GL33;
+
+   // A feature only counts if glad found its entry points too
+   caps->direct_state_access = (version >= 45 || GLAD_GL_ARB_direct_state_access) &&
+         glNamedBufferSubData && glTextureSubImage2D && glCreateTextures && glTextureStorage2D &&
+         glTextureParameteri;
+   caps->buffer_storage = (version >= 44 || GLAD_GL_ARB_buffer_storage) && glBufferStorage;
+   caps->multi_draw_indirect = (version >= 43 || GLAD_GL_ARB_multi_draw_indirect) && glMultiDrawArraysIndirect;
+   caps->invalidate_subdata = (version >= 43 || GLAD_GL_ARB_invalidate_subdata) && glInvalidateFramebuffer;
+}
+
+const char *gpu_tier_name(unsigned tier) {
+   switch (tier) {
+   case GPU_TIER_GL45:
+      return "GL 4.5";
+   case GPU_TIER_GL43:
+      return "GL 4.3";
+   case GPU_TIER_GLES3:
+      return "GLES 3";
+   default:
+      return "GL 3.3";
+   }
+}
+
+void gpu_buffer_update(const gpu_caps *caps, GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data) {
+   if (caps->direct_state_access) {
+      glNamedBufferSubData(buffer, offset, size, data);
+      return;
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, buffer);
+   glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void gpu_texture_update(const gpu_caps *caps, GLuint texture, GLint x, GLint y, GLsizei width, GLsizei height,
+      GLenum format, GLenum type, const void *pixels) {
+   if (caps->direct_state_access) {
+      glTextureSubImage2D(texture, 0, x, y, width, height, format, type, pixels);
+      return;
+   }
+   glBindTexture(GL_TEXTURE_2D, texture);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, type, pixels);
+   glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// ---- Streams ----
+
+static bool create_ring(gpu_stream *stream) {
+   GLsizeiptr size = stream->segment * GPU_STREAM_SEGMENTS;
+   glGenBuffers(1, &stream->buffer);
+   glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+   if (stream->caps->buffer_storage) {
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+      stream->persistent = (uint8_t *)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+      if (!stream->persistent)
+         return false;
+   } else {
+      glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+   }
+   stream->head = 0;
+   return true;
+}
+
+// Deleting a buffer the GPU still reads is safe: GL keeps its storage
+// until those draws are done
+static void destroy_ring(gpu_stream *stream) {
+   unsigned i;
+   for (i = 0; i < GPU_STREAM_SEGMENTS; i++) {
+      if (stream->fences[i])
+         glDeleteSync(stream->fences[i]);
+      stream->fences[i] = 0;
+   }
+   if (stream->buffer) {
+      if (stream->persistent || stream->mapped) {
+         glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+         glUnmapBuffer(GL_ARRAY_BUFFER);
+      }
+      glDeleteBuffers(1, &stream->buffer);
+   }
+   stream->buffer = 0;
+   stream->persistent = NULL;
+   stream->mapped = false;
+}
+
+bool gpu_stream_init(gpu_stream *stream, const gpu_caps *caps, GLsizeiptr segment) {
+   memset(stream, 0, sizeof(*stream));
+   stream->caps = caps;
+   stream->segment = (segment + GPU_STREAM_ALIGN - 1) & ~(GLsizeiptr)(GPU_STREAM_ALIGN - 1);
+   if (!create_ring(stream)) {
+      gpu_stream_deinit(stream);
+      return false;
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   return true;
+}
+
+void gpu_stream_deinit(gpu_stream *stream) {
+   destroy_ring(stream);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   memset(stream, 0, sizeof(*stream));
+}
+
+static void wait_fence(gpu_stream *stream, unsigned segment) {
+   GLsync fence = stream->fences[segment];
+   if (!fence)
+      return;
+   if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      stream->fence_waits++;
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+   }
+   glDeleteSync(fence);
+   stream->fences[segment] = 0;
+}
+
+void *gpu_stream_map(gpu_stream *stream, GLsizeiptr size, GLintptr *offset) {
+   GLsizeiptr start = (stream->head + GPU_STREAM_ALIGN - 1) & ~(GLsizeiptr)(GPU_STREAM_ALIGN - 1);
+   unsigned current = (unsigned)((stream->head ? stream->head - 1 : 0) / stream->segment);
+   void *ptr;
+
+   if (size > stream->segment) {
+      // Start over with segments that fit
+      GLsizeiptr segment = stream->segment;
+      while (segment < size)
+         segment *= 2;
+      destroy_ring(stream);
+      stream->segment = segment;
+      if (!create_ring(stream))
+         return NULL;
+      start = 0;
+   } else if (start + size > (GLsizeiptr)(current + 1) * stream->segment) {
+      // Leaving a segment: fence the draws reading it, and make sure the
+      // GPU is done with the one we enter
+      unsigned next = (current + 1) % GPU_STREAM_SEGMENTS;
+      glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+      if (stream->persistent) {
+         stream->fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+         wait_fence(stream, next);
+      } else if (next == 0) {
+         glBufferData(GL_ARRAY_BUFFER, stream->segment * GPU_STREAM_SEGMENTS, NULL, GL_STREAM_DRAW);
+      }
+      start = (GLsizeiptr)next * stream->segment;
+   }
+   stream->head = start + size;
+   *offset = (GLintptr)start;
+
+   glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+   if (stream->persistent)
+      return stream->persistent + start;
+   ptr = glMapBufferRange(GL_ARRAY_BUFFER, start, size,
+         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+   stream->mapped = ptr != NULL;
+   return ptr;
+}
+
+void gpu_stream_unmap(gpu_stream *stream) {
+   if (!stream->mapped)
+      return;
+   glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+   glUnmapBuffer(GL_ARRAY_BUFFER);
+   stream->mapped = false;
+}
+
+// ---- Vertex formats ----
+
+void gpu_attrib_pointer(const gpu_attrib *attrib, GLsizei stride, GLintptr base) {
+   static const GLenum types[] = { GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT };
+   GLboolean normalized = attrib->type == GPU_ATTRIB_UNORM8 || attrib->type == GPU_ATTRIB_UNORM16;
+   glVertexAttribPointer(attrib->location, attrib->components, types[attrib->type], normalized, stride,
+         (const void *)(uintptr_t)(base + attrib->offset));
+}
+
+void gpu_vertex_format_apply(const gpu_vertex_format *format, GLintptr base) {
+   unsigned i;
+   for (i = 0; i < format->count; i++) {
+      glEnableVertexAttribArray(format->attribs[i].location);
+      gpu_attrib_pointer(&format->attribs[i], format->stride, base);
+   }
+}
@@ -0,0 +1,138 @@
+#ifndef GPU_H
+#define GPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+#include <retro_inline.h>
+
+#define GPU_STREAM_SEGMENTS 3 // Ring thirds; one is written while two may be in flight
+#define GPU_STREAM_ALIGN 64   // Reservation alignment, bytes
+
+// Capability tiers above the GL 3.3 core baseline
+enum gpu_tier {
+   GPU_TIER_GL33,
+   GPU_TIER_GL43, // Multi-draw indirect, framebuffer invalidation
+   GPU_TIER_GL45, // Direct state access
+   GPU_TIER_GLES3 // OpenGL ES 3.x: the 3.3 paths plus framebuffer invalidation
+};
+
+// What the current context can do, detected once per context reset. Each
+// feature is taken from its core version or its ARB extension, whichever
+// the driver offers; the tier only summarizes the version. With the
+// baseline forced, every feature reads false and all paths are plain 3.3.
+// On GLES the version is the ES one and only invalidation, core in ES 3.0,
+// is used; the rest have no ES 3.0 equivalent.
+typedef struct gpu_caps {
+   int major, minor;
+   unsigned tier;
+   bool gles;                // OpenGL ES context
+   bool direct_state_access; // 4.5 / ARB_direct_state_access
+   bool buffer_storage;      // 4.4 / ARB_buffer_storage: persistent mapping
+   bool multi_draw_indirect; // 4.3 / ARB_multi_draw_indirect
+   bool invalidate_subdata;  // 4.3 / ARB_invalidate_subdata
+} gpu_caps;
+
+// Needs a current context with glad loaded
+void gpu_caps_detect(gpu_caps *caps, bool gles, bool force_baseline);
+const char *gpu_tier_name(unsigned tier);
+
+// Backend-neutral updates: DSA when available, otherwise bind, update and
+// unbind. The bind path leaves GL_ARRAY_BUFFER / the texture on the active
+// unit unbound.
+void gpu_buffer_update(const gpu_caps *caps, GLuint buffer, GLintptr offset, GLsizeiptr size, const void *data);
+void gpu_texture_update(const gpu_caps *caps, GLuint texture, GLint x, GLint y, GLsizei width, GLsizei height,
+      GLenum format, GLenum type, const void *pixels);
+
+// Ring buffer for data written every frame (vertex and instance streams).
+// With buffer storage it is mapped persistently and coherently for its
+// whole life: a reservation is a pointer into the mapping, and a fence
+// guards each segment against being overwritten while the GPU still reads
+// it. On the baseline each reservation maps its range unsynchronized, and
+// the buffer is orphaned whenever the ring wraps, so nothing in flight is
+// ever written over either. A reservation larger than a segment replaces
+// the ring with one whose segments fit it; GL frees the old buffer once
+// the GPU is done with it.
+typedef struct gpu_stream {
+   const gpu_caps *caps;
+   GLuint buffer;
+   GLsizeiptr segment; // Bytes per segment
+   GLsizeiptr head;    // Next free byte
+   uint8_t *persistent; // Whole-buffer mapping with buffer storage
+   bool mapped;         // A baseline reservation is mapped
+   GLsync fences[GPU_STREAM_SEGMENTS];
+   uint64_t fence_waits; // Reservations that waited on the GPU
+} gpu_stream;
+
+bool gpu_stream_init(gpu_stream *stream, const gpu_caps *caps, GLsizeiptr segment);
+void gpu_stream_deinit(gpu_stream *stream);
+// Reserve size bytes and return where to write them, with their offset in
+// stream->buffer; NULL if the ring couldn't grow. Leaves GL_ARRAY_BUFFER
+// bound to the stream.
+void *gpu_stream_map(gpu_stream *stream, GLsizeiptr size, GLintptr *offset);
+// Finish writing the last reservation; call before drawing from it
+void gpu_stream_unmap(gpu_stream *stream);
+
+// ---- Vertex formats ----
+
+// Attribute encodings. Pixel positions are 12.4 fixed point in a signed
+// short (GPU_ATTRIB_PIXEL, -2048 to 2047.9375 pixels in 1/16 steps): the
+// shader multiplies by 1 / GPU_PIXEL_SCALE. Everything else reaches the
+// shader as the float it stands for.
+enum gpu_attrib_type {
+   GPU_ATTRIB_FLOAT,
+   GPU_ATTRIB_HALF,
+   GPU_ATTRIB_PIXEL,  // int16, unnormalized, scaled in the shader
+   GPU_ATTRIB_UNORM8,
+   GPU_ATTRIB_UNORM16
+};
+
+#define GPU_PIXEL_SCALE 16.0f
+#define GPU_FORMAT_MAX_ATTRIBS 4
+
+typedef struct gpu_attrib {
+   uint8_t location, components, type, offset;
+} gpu_attrib;
+
+// An interleaved vertex layout, one per kind of batch
+typedef struct gpu_vertex_format {
+   uint8_t stride, count;
+   gpu_attrib attribs[GPU_FORMAT_MAX_ATTRIBS];
+} gpu_vertex_format;
+
+// Point one attribute at base in the buffer bound to GL_ARRAY_BUFFER
+void gpu_attrib_pointer(const gpu_attrib *attrib, GLsizei stride, GLintptr base);
+// Enable and point every attribute of format; the VAO must be bound
+void gpu_vertex_format_apply(const gpu_vertex_format *format, GLintptr base);
+
+static INLINE int16_t gpu_pack_pixel(float pixels) {
+   float v = pixels * GPU_PIXEL_SCALE;
+   if (v <= -32768.0f)
+      return -32768;
+   if (v >= 32767.0f)
+      return 32767;
+   return (int16_t)(v < 0.0f ? v - 0.5f : v + 0.5f);
+}
+
+// IEEE half, rounded to nearest (ties away from zero); overflow becomes
+// infinity
+static INLINE uint16_t gpu_pack_half(float f) {
+   union { float f; uint32_t u; } v;
+   uint32_t sign, exp, mant;
+   v.f = f;
+   sign = (v.u >> 16) & 0x8000u;
+   exp = (v.u >> 23) & 0xffu;
+   mant = v.u & 0x7fffffu;
+   if (exp >= 143)
+      return (uint16_t)(sign | 0x7c00u);
+   if (exp <= 112) {
+      // Subnormal half, or zero
+      if (exp < 102)
+         return (uint16_t)sign;
+      mant |= 0x800000u;
+      return (uint16_t)(sign | ((mant >> (126 - exp)) + ((mant >> (125 - exp)) & 1)));
+   }
+   return (uint16_t)(sign | ((((exp - 112) << 10) | (mant >> 13)) + ((mant >> 12) & 1)));
+}
+
+#endif // GPU_H
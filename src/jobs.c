@@ -0,0 +1,374 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np
+#endif
+#include "jobs.h"
+#include "alloc.h"
+#include <string.h>
+#include <stdint.h>
+#include <rthreads/rthreads.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#endif
+
+#define JOB_DEQUE_MASK (JOB_DEQUE_CAPACITY - 1)
+#define JOB_SPINS_BEFORE_SLEEP 256
+#define JOB_SLEEP_TIMEOUT_USEC 1000
+
+struct job {
+   job_func_t func;
+   void *data;
+   unsigned begin, end;
+   job_counter_t *counter;
+};
+
+// Per-thread state. top is written by thieves and bottom by the owner, so
+// keep them on separate cache lines.
+typedef struct job_slot {
+   atomic_i64 top;
+   char pad0[64 - sizeof(int64_t)];
+   atomic_i64 bottom;
+   char pad1[64 - sizeof(int64_t)];
+   job_t *buffer[JOB_DEQUE_CAPACITY];
+   job_t pool[JOB_POOL_SIZE];
+   unsigned pool_next;
+   unsigned index;
+   uint32_t rng;
+   job_system_t *js;
+} job_slot;
+
+struct job_system {
+   unsigned num_threads; // Owner + workers
+   job_slot *slots;      // slots[0] belongs to the owner
+   sthread_t *threads[JOB_MAX_WORKERS];
+   atomic_i32 shutdown;
+   atomic_i32 sleepers;
+   slock_t *sleep_lock;
+   scond_t *sleep_cond;
+   bool affinity;
+   unsigned cpu_base; // Pinned workers take CPUs from here on
+};
+
+// Slot of the calling thread, if it is a worker
+static CORE_THREAD_LOCAL job_slot *current_worker = NULL;
+
+// CPUs taken by pinned job systems so far, across every instance in the
+// process: worker n (slots count from 1) of the next one takes CPU
+// next_cpu + n, so instances spread over the machine instead of all
+// pinning to the lowest CPUs
+static atomic_i32 next_cpu = 0;
+
+unsigned job_cpu_count(void) {
+#if defined(_WIN32)
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwNumberOfProcessors;
+#else
+   long n = sysconf(_SC_NPROCESSORS_ONLN);
+   return n > 0 ? (unsigned)n : 1;
+#endif
+}
+
+static job_slot *current_slot(job_system_t *js) {
+   if (current_worker && current_worker->js == js)
+      return current_worker;
+   return &js->slots[0];
+}
+
+// Chase-Lev deque. Only the owning thread pushes and pops at the bottom;
+// any thread may steal from the top.
+static bool deque_push(job_slot *slot, job_t *job) {
+   int64_t b = atomic_load_i64(&slot->bottom);
+   int64_t t = atomic_load_i64(&slot->top);
+   if (b - t >= JOB_DEQUE_CAPACITY)
+      return false;
+   atomic_store_ptr(&slot->buffer[b & JOB_DEQUE_MASK], job);
+   atomic_store_i64(&slot->bottom, b + 1);
+   return true;
+}
+
+static job_t *deque_pop(job_slot *slot) {
+   int64_t b = atomic_load_i64(&slot->bottom) - 1;
+   atomic_store_i64(&slot->bottom, b);
+   int64_t t = atomic_load_i64(&slot->top);
+   if (t > b) {
+      atomic_store_i64(&slot->bottom, b + 1);
+      return NULL;
+   }
+   job_t *job = (job_t *)atomic_load_ptr(&slot->buffer[b & JOB_DEQUE_MASK]);
+   if (t != b)
+      return job;
+   // Last item: race thieves for it
+   if (!atomic_cas_i64(&slot->top, t, t + 1))
+      job = NULL;
+   atomic_store_i64(&slot->bottom, b + 1);
+   return job;
+}
+
+static job_t *deque_steal(job_slot *slot) {
+   int64_t t = atomic_load_i64(&slot->top);
+   int64_t b = atomic_load_i64(&slot->bottom);
+   if (t >= b)
+      return NULL;
+   job_t *job = (job_t *)atomic_load_ptr(&slot->buffer[t & JOB_DEQUE_MASK]);
+   if (!atomic_cas_i64(&slot->top, t, t + 1))
+      return NULL;
+   return job;
+}
+
+static job_t *find_job(job_system_t *js, job_slot *slot) {
+   job_t *job = deque_pop(slot);
+   if (job || js->num_threads == 1)
+      return job;
+
+   // xorshift32 picks where to start stealing
+   slot->rng ^= slot->rng << 13;
+   slot->rng ^= slot->rng >> 17;
+   slot->rng ^= slot->rng << 5;
+   unsigned start = slot->rng % js->num_threads;
+   unsigned i;
+   for (i = 0; i < js->num_threads; i++) {
+      job_slot *victim = &js->slots[(start + i) % js->num_threads];
+      if (victim == slot)
+         continue;
+      job = deque_steal(victim);
+      if (job)
+         return job;
+   }
+   return NULL;
+}
+
+static job_t *alloc_job(job_system_t *js, job_func_t func, void *data,
+      unsigned begin, unsigned end, job_counter_t *counter) {
+   job_slot *slot = current_slot(js);
+   job_t *job = &slot->pool[slot->pool_next++ & (JOB_POOL_SIZE - 1)];
+   job->func = func;
+   job->data = data;
+   job->begin = begin;
+   job->end = end;
+   job->counter = counter;
+   if (counter)
+      atomic_fetch_add_i32(&counter->value, 1);
+   return job;
+}
+
+static void push_job(job_system_t *js, job_t *job);
+
+static void finish_job(job_system_t *js, job_t *job) {
+   job_counter_t *counter = job->counter;
+   job_t *ready[JOB_MAX_CONTINUATIONS];
+   unsigned num_ready = 0, i;
+   if (!counter)
+      return;
+
+   spin_lock(&counter->lock);
+   if (atomic_fetch_add_i32(&counter->value, -1) == 1) {
+      num_ready = counter->num_continuations;
+      memcpy(ready, counter->continuations, num_ready * sizeof(*ready));
+      counter->num_continuations = 0;
+   }
+   spin_unlock(&counter->lock);
+
+   for (i = 0; i < num_ready; i++)
+      push_job(js, ready[i]);
+}
+
+static void execute_job(job_system_t *js, job_t *job) {
+   job->func(job->data, job->begin, job->end);
+   finish_job(js, job);
+}
+
+static void push_job(job_system_t *js, job_t *job) {
+   if (js->num_threads == 1 || !deque_push(current_slot(js), job)) {
+      // No workers, or the deque is full: run it here
+      execute_job(js, job);
+      return;
+   }
+   if (atomic_load_i32(&js->sleepers) > 0) {
+      slock_lock(js->sleep_lock);
+      scond_signal(js->sleep_cond);
+      slock_unlock(js->sleep_lock);
+   }
+}
+
+static void set_worker_affinity(unsigned cpu) {
+#if defined(_WIN32)
+   SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#elif defined(__linux__)
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+   (void)cpu; // Affinity hints unsupported; ignore
+#endif
+}
+
+static void worker_main(void *userdata) {
+   job_slot *slot = (job_slot *)userdata;
+   job_system_t *js = slot->js;
+   unsigned idle_spins = 0;
+
+   current_worker = slot;
+   if (js->affinity)
+      set_worker_affinity((js->cpu_base + slot->index) % job_cpu_count());
+
+   while (!atomic_load_i32(&js->shutdown)) {
+      job_t *job = find_job(js, slot);
+      if (job) {
+         execute_job(js, job);
+         idle_spins = 0;
+         continue;
+      }
+      if (++idle_spins < JOB_SPINS_BEFORE_SLEEP) {
+         cpu_relax();
+         continue;
+      }
+      // Pushes signal sleepers; the timeout covers a wakeup that races
+      // with going to sleep
+      slock_lock(js->sleep_lock);
+      atomic_fetch_add_i32(&js->sleepers, 1);
+      if (!atomic_load_i32(&js->shutdown))
+         scond_wait_timeout(js->sleep_cond, js->sleep_lock, JOB_SLEEP_TIMEOUT_USEC);
+      atomic_fetch_add_i32(&js->sleepers, -1);
+      slock_unlock(js->sleep_lock);
+      idle_spins = 0;
+   }
+   current_worker = NULL;
+}
+
+job_system_t *job_system_create(unsigned workers, bool affinity) {
+   unsigned i;
+   if (workers > JOB_MAX_WORKERS)
+      workers = JOB_MAX_WORKERS;
+
+   job_system_t *js = (job_system_t *)core_calloc(1, sizeof(*js));
+   if (!js)
+      return NULL;
+   js->num_threads = workers + 1;
+   js->affinity = affinity;
+   if (affinity)
+      js->cpu_base = (unsigned)atomic_fetch_add_i32(&next_cpu, (int32_t)workers);
+   js->slots = (job_slot *)core_calloc(js->num_threads, sizeof(*js->slots));
+   js->sleep_lock = slock_new();
+   js->sleep_cond = scond_new();
+   if (!js->slots || !js->sleep_lock || !js->sleep_cond) {
+      job_system_destroy(js);
+      return NULL;
+   }
+   for (i = 0; i < js->num_threads; i++) {
+      js->slots[i].index = i;
+      js->slots[i].rng = 0x9e3779b9u * (i + 1);
+      js->slots[i].js = js;
+   }
+   for (i = 1; i < js->num_threads; i++) {
+      // A worker that fails to start leaves an idle slot; the others
+      // simply never find work there
+      js->threads[i - 1] = sthread_create(worker_main, &js->slots[i]);
+   }
+   return js;
+}
+
+void job_system_destroy(job_system_t *js) {
+   unsigned i;
+   if (!js)
+      return;
+   atomic_store_i32(&js->shutdown, 1);
+   if (js->sleep_lock && js->sleep_cond) {
+      slock_lock(js->sleep_lock);
+      scond_broadcast(js->sleep_cond);
+      slock_unlock(js->sleep_lock);
+   }
+   for (i = 0; i + 1 < js->num_threads; i++)
+      if (js->threads[i])
+         sthread_join(js->threads[i]);
+   if (js->sleep_cond)
+      scond_free(js->sleep_cond);
+   if (js->sleep_lock)
+      slock_free(js->sleep_lock);
+   core_free(js->slots);
+   core_free(js);
+}
+
+unsigned job_system_thread_count(const job_system_t *js) {
+   return js ? js->num_threads : 1;
+}
+
+bool job_system_pinned(const job_system_t *js) {
+   return js && js->affinity;
+}
+
+void job_counter_init(job_counter_t *counter) {
+   memset(counter, 0, sizeof(*counter));
+}
+
+void job_run(job_system_t *js, job_func_t func, void *data, job_counter_t *counter) {
+   push_job(js, alloc_job(js, func, data, 0, 0, counter));
+}
+
+void job_run_after(job_system_t *js, job_counter_t *dependency, job_func_t func,
+      void *data, job_counter_t *counter) {
+   job_t *job = alloc_job(js, func, data, 0, 0, counter);
+
+   spin_lock(&dependency->lock);
+   if (atomic_load_i32(&dependency->value) > 0 &&
+         dependency->num_continuations < JOB_MAX_CONTINUATIONS) {
+      dependency->continuations[dependency->num_continuations++] = job;
+      spin_unlock(&dependency->lock);
+      return;
+   }
+   spin_unlock(&dependency->lock);
+
+   // Dependency already done, or no room to park the job: wait it out
+   job_wait(js, dependency);
+   push_job(js, job);
+}
+
+void job_run_range(job_system_t *js, job_func_t func, void *data, unsigned count,
+      unsigned grain, job_counter_t *counter) {
+   if (count == 0)
+      return;
+   if (grain == 0)
+      grain = 1;
+   // Enough chunks to balance across threads without drowning in jobs
+   unsigned chunks = (count + grain - 1) / grain;
+   unsigned max_chunks = job_system_thread_count(js) * 4;
+   if (chunks > max_chunks)
+      chunks = max_chunks;
+   unsigned chunk_size = (count + chunks - 1) / chunks;
+   unsigned begin;
+   for (begin = 0; begin < count; begin += chunk_size) {
+      unsigned end = begin + chunk_size < count ? begin + chunk_size : count;
+      push_job(js, alloc_job(js, func, data, begin, end, counter));
+   }
+}
+
+void job_wait(job_system_t *js, job_counter_t *counter) {
+   job_slot *slot = current_slot(js);
+   // Also wait for the lock: the finishing thread still holds it right after
+   // the count drops to zero, and the counter often lives on our stack
+   while (atomic_load_i32(&counter->value) > 0 || atomic_load_i32(&counter->lock)) {
+      job_t *job = find_job(js, slot);
+      if (job)
+         execute_job(js, job);
+      else
+         cpu_relax();
+   }
+}
+
+void job_parallel_for(job_system_t *js, job_func_t func, void *data, unsigned count, unsigned grain) {
+   job_counter_t counter;
+   if (!js || js->num_threads == 1 || count <= grain) {
+      if (count)
+         func(data, 0, count);
+      return;
+   }
+   job_counter_init(&counter);
+   job_run_range(js, func, data, count, grain, &counter);
+   job_wait(js, &counter);
+}
@@ -0,0 +1,73 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+#include "atomics.h"
+
+// Work-stealing job system: a fixed pool of worker threads, one Chase-Lev
+// deque per thread, and counters for dependencies. The thread that owns the
+// job system (the core instance's thread) has its own deque and runs jobs
+// while it waits, so a pool with zero workers degrades to inline execution.
+//
+// Jobs come from fixed per-thread pools; nothing here allocates after
+// job_system_create().
+
+#define JOB_DEQUE_CAPACITY 1024 // Power of two
+#define JOB_POOL_SIZE 4096      // Per thread; must exceed live jobs per submitter
+#define JOB_MAX_CONTINUATIONS 16
+#define JOB_MAX_WORKERS 64
+
+// A job processes [begin, end) of whatever data points at. Single jobs get
+// begin = end = 0.
+typedef void (*job_func_t)(void *data, unsigned begin, unsigned end);
+
+typedef struct job job_t;
+
+// Counts outstanding jobs. Jobs started with a counter increment it and
+// decrement it when they finish; jobs queued with job_run_after() start
+// when their dependency reaches zero.
+typedef struct job_counter {
+   atomic_i32 value;
+   atomic_i32 lock;
+   job_t *continuations[JOB_MAX_CONTINUATIONS];
+   unsigned num_continuations;
+} job_counter_t;
+
+typedef struct job_system job_system_t;
+
+// workers: number of threads besides the owner (0 = run everything inline).
+// affinity: pin workers to consecutive CPUs from CPU 1, leaving CPU 0 to
+// the owner. Each further pinned job system in the process continues after
+// the previous one's CPUs, wrapping around the CPU count.
+job_system_t *job_system_create(unsigned workers, bool affinity);
+void job_system_destroy(job_system_t *js);
+
+// Threads executing jobs, including the owner
+unsigned job_system_thread_count(const job_system_t *js);
+
+// Whether the workers were created pinned
+bool job_system_pinned(const job_system_t *js);
+
+// Logical CPUs in the machine
+unsigned job_cpu_count(void);
+
+void job_counter_init(job_counter_t *counter);
+
+// Queue one job. counter may be NULL.
+void job_run(job_system_t *js, job_func_t func, void *data, job_counter_t *counter);
+
+// Queue a job that starts once dependency reaches zero
+void job_run_after(job_system_t *js, job_counter_t *dependency, job_func_t func,
+      void *data, job_counter_t *counter);
+
+// Split [0, count) into chunks of at least grain items and queue them
+void job_run_range(job_system_t *js, job_func_t func, void *data, unsigned count,
+      unsigned grain, job_counter_t *counter);
+
+// Run jobs on the calling thread until counter reaches zero
+void job_wait(job_system_t *js, job_counter_t *counter);
+
+// job_run_range + job_wait
+void job_parallel_for(job_system_t *js, job_func_t func, void *data, unsigned count, unsigned grain);
+
+#endif // JOBS_H
@@ -1,170 +1,1114 @@
+// Headless host harness for the core.
+//
+// Drives core instances through the core_* API (src/core.h) with offscreen
+// OpenGL contexts: EGL surfaceless on Linux render boxes (HARNESS_EGL), a
+// hidden GLFW window everywhere else.
+//
+// Usage:
+//   core_harness run [frames]
+//   core_harness bench [max_instances] [seconds] [--log] [--threads-only|--processes-only]
+//   core_harness offline [seconds] [frames_per_run]
+//   core_harness startup [runs]      (startup phase timings as JSON)
+//   core_harness reconfigure [frames] (toggles options at runtime, depth 3)
+//   core_harness shard [seconds]      (internal: one instance, prints fps)
+//
+// Any command accepts --option key=value to answer GET_VARIABLE, --gles
+// to act as a GLES-only frontend: contexts are OpenGL ES 3.0 and only
+// RETRO_HW_CONTEXT_OPENGLES3 is accepted, and --no-hw to act as a frontend
+// without GPU contexts, which the core answers with software frames.
+#if !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE // dl_iterate_phdr
+#endif
 #include <glad/glad.h>
+#ifdef HARNESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#else
 #include <GLFW/glfw3.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <rthreads/rthreads.h>
+#include <retro_timers.h>
+#include "core.h"
+#include "atomics.h"
+#include "alloc.h"
+#ifdef _WIN32
+#include <windows.h>
+#define popen _popen
+#define pclose _pclose
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+#if defined(__GLIBC__)
+#include <link.h>
+#include <execinfo.h>
+#endif
 
-// Vertex data for a triangle (position and color)
-static const float vertices[] = {
-    // Positions        // Colors
-    -0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 0.0f, // Bottom-left
-     0.5f, -0.5f, 0.0f, 0.0f, 1.0f, 0.0f, // Bottom-right
-     0.0f,  0.5f, 0.0f, 0.0f, 0.0f, 1.0f  // Top
-};
+#define MAX_INSTANCES 256
+#define MAX_OPTIONS 32
+#define WARMUP_FRAMES 16 // Frames allowed to allocate before run checks the heap
+#define MAX_STARTUP_RUNS 64
+
+// Offscreen GL context, one per core instance
+typedef struct harness_context {
+#ifdef HARNESS_EGL
+    EGLContext context;
+#else
+    GLFWwindow *window;
+#endif
+} harness_context;
+
+// Host-side state for one core instance
+typedef struct host_instance {
+    harness_context ctx;
+    core_t *core;
+    struct retro_hw_render_callback *hw_render;
+    GLuint fbo, color_tex, depth_rb;
+    sthread_t *thread;
+    unsigned frames;
+    double seconds;
+    bool ok;
+    // Offline mode frame sink statistics
+    uint64_t sink_frames;
+    uint32_t sink_checksum;
+    int64_t first_present; // When video_cb first ran, 0 = not yet
+    // Last software frame (--no-hw), owned by the core
+    const void *frame;
+    size_t frame_pitch;
+} host_instance;
+
+// Host-side timestamps of one instance start
+typedef struct startup_marks {
+    int64_t start, environment, init, load_game, context_reset;
+} startup_marks;
+
+// Core option overrides from --option key=value
+typedef struct host_option {
+    char key[64];
+    char value[64];
+} host_option;
+
+static host_option options[MAX_OPTIONS];
+static unsigned option_count = 0;
+// Set when options change mid-run; GET_VARIABLE_UPDATE reports and clears it
+static atomic_i32 options_updated = 0;
+// Errors the core logged, counted whether or not logging is enabled
+static atomic_i32 error_logs = 0;
+
+// Shared start/stop flags for a benchmark round
+static atomic_i32 ready_count = 0;
+static atomic_i32 start_flag = 0;
+static atomic_i32 stop_flag = 0;
+
+// Core logging: dropped unless --log routes it through one locked sink,
+// which is what a frontend logger looks like under contention.
+static bool log_enabled = false;
+static slock_t *log_lock = NULL;
+static FILE *log_sink = NULL;
+
+// --gles: OpenGL ES 3.0 contexts instead of desktop 3.3 core
+static bool use_gles = false;
+// --no-hw: refuse every HW context, take XRGB8888 software frames
+static bool no_hw = false;
+
+#ifdef HARNESS_EGL
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+#endif
+
+#if defined(__GLIBC__)
+// Malloc interposer: allocations the core makes on a frame's threads,
+// directly or through the C library (qsort, stdio), are reported to the
+// core's accounting, which counts and traps them like core_malloc calls.
+// Allocations the GL driver makes inside GL calls are left out: a frame
+// can't avoid them. free and the aligned allocators stay glibc's; they
+// handle these blocks as their own.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+// Address range of a loaded object's segments; start holds an address in
+// the object until dl_iterate_phdr finds it
+typedef struct code_range {
+    uintptr_t start, end;
+} code_range;
+
+static code_range exe_code, libc_code;
+
+static int find_code_range(struct dl_phdr_info *info, size_t size, void *data) {
+    code_range *range = (code_range *)data;
+    uintptr_t lo = UINTPTR_MAX, hi = 0;
+    bool found = false;
+    int i;
+    (void)size;
+    for (i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+        uintptr_t start = info->dlpi_addr + ph->p_vaddr, end = start + ph->p_memsz;
+        if (ph->p_type != PT_LOAD)
+            continue;
+        lo = start < lo ? start : lo;
+        hi = end > hi ? end : hi;
+        found |= range->start >= start && range->start < end;
+    }
+    if (!found)
+        return 0;
+    range->start = lo;
+    range->end = hi;
+    return 1;
+}
+
+// Find the executable (the core is linked in) and the C library once, so
+// the interposer mostly compares addresses
+static void alloc_interposer_init(void) {
+    code_range exe = { (uintptr_t)find_code_range, 0 }, libc = { (uintptr_t)qsort, 0 };
+    void *frames[1];
+    dl_iterate_phdr(find_code_range, &exe);
+    dl_iterate_phdr(find_code_range, &libc);
+    exe_code = exe;
+    libc_code = libc;
+    backtrace(frames, 1); // Loads the unwinder now rather than inside a frame
+}
 
-// Vertex shader source
-static const char* vertex_shader_src =
-    "#version 330 core\n"
-    "layout(location = 0) in vec3 aPos;\n"
-    "layout(location = 1) in vec3 aColor;\n"
-    "out vec3 vColor;\n"
-    "void main() {\n"
-    "    gl_Position = vec4(aPos, 1.0);\n"
-    "    vColor = aColor;\n"
-    "}\n";
-
-// Fragment shader source
-static const char* fragment_shader_src =
-    "#version 330 core\n"
-    "in vec3 vColor;\n"
-    "out vec4 FragColor;\n"
-    "void main() {\n"
-    "    FragColor = vec4(vColor, 1.0);\n"
-    "}\n";
-
-// Error callback for GLFW
-static void error_callback(int error, const char* description) {
-    fprintf(stderr, "GLFW Error %d: %s\n", error, description);
-}
-
-// Key callback to close window on ESC
-static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, GLFW_TRUE);
-}
-
-int main() {
-    // Set GLFW error callback
-    glfwSetErrorCallback(error_callback);
-
-    // Initialize GLFW
+static bool in_code_range(const code_range *range, void *addr) {
+    return (uintptr_t)addr >= range->start && (uintptr_t)addr < range->end;
+}
+
+// Whether an allocation whose malloc call returns to caller was made by
+// the core. A call from the C library (qsort, asprintf) is the core's if
+// the first frame below the library is, and the driver's otherwise.
+static bool core_caller(void *caller) {
+    void *frames[32];
+    int i, n;
+    if (in_code_range(&exe_code, caller))
+        return true;
+    if (!in_code_range(&libc_code, caller))
+        return false;
+    n = backtrace(frames, 32);
+    for (i = 0; i < n && frames[i] != caller; i++)
+        ;
+    while (i < n && in_code_range(&libc_code, frames[i]))
+        i++;
+    return i == n || in_code_range(&exe_code, frames[i]);
+}
+
+void *malloc(size_t size) {
+    if (core_alloc_in_frame() && core_caller(__builtin_return_address(0)))
+        core_alloc_note_foreign(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    if (core_alloc_in_frame() && core_caller(__builtin_return_address(0)))
+        core_alloc_note_foreign(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (core_alloc_in_frame() && core_caller(__builtin_return_address(0)))
+        core_alloc_note_foreign(size);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+// Monotonic time in microseconds
+static int64_t harness_time_usec(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+    if (!freq.QuadPart)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (int64_t)(count.QuadPart * 1000000 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+static unsigned harness_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+#endif
+}
+
+// Context platform
+static bool context_platform_init(void) {
+#ifdef HARNESS_EGL
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display)
+        egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (egl_display == EGL_NO_DISPLAY)
+        egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+        fprintf(stderr, "Failed to initialize EGL\n");
+        return false;
+    }
+    if (!eglBindAPI(use_gles ? EGL_OPENGL_ES_API : EGL_OPENGL_API)) {
+        fprintf(stderr, "EGL has no %s support\n", use_gles ? "OpenGL ES" : "desktop OpenGL");
+        return false;
+    }
+    return true;
+#else
     if (!glfwInit()) {
         fprintf(stderr, "Failed to initialize GLFW\n");
-        return -1;
+        return false;
     }
+    return true;
+#endif
+}
+
+static void context_platform_shutdown(void) {
+#ifdef HARNESS_EGL
+    eglTerminate(egl_display);
+#else
+    glfwTerminate();
+#endif
+}
 
-    // Configure GLFW for OpenGL 3.3 core profile
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+// Create an OpenGL 3.3 core (or ES 3.0) context; call from the main thread
+static bool context_create(harness_context *ctx) {
+#ifdef HARNESS_EGL
+    static const EGLint attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    static const EGLint gles_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 0,
+        EGL_NONE
+    };
+    ctx->context = eglCreateContext(egl_display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, use_gles ? gles_attribs : attribs);
+    return ctx->context != EGL_NO_CONTEXT;
+#else
+    if (use_gles) {
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    } else {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    }
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    if (!use_gles)
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    ctx->window = glfwCreateWindow(64, 64, "core_harness", NULL, NULL);
+    return ctx->window != NULL;
+#endif
+}
+
+// Make a context current on the calling thread (NULL releases it)
+static void context_make_current(harness_context *ctx) {
+#ifdef HARNESS_EGL
+    eglBindAPI(use_gles ? EGL_OPENGL_ES_API : EGL_OPENGL_API); // Per thread
+    eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx ? ctx->context : EGL_NO_CONTEXT);
+#else
+    glfwMakeContextCurrent(ctx ? ctx->window : NULL);
+#endif
+}
+
+static void context_destroy(harness_context *ctx) {
+#ifdef HARNESS_EGL
+    if (ctx->context != EGL_NO_CONTEXT)
+        eglDestroyContext(egl_display, ctx->context);
+    ctx->context = EGL_NO_CONTEXT;
+#else
+    if (ctx->window)
+        glfwDestroyWindow(ctx->window);
+    ctx->window = NULL;
+#endif
+}
+
+static retro_proc_address_t harness_get_proc_address(const char *sym) {
+#ifdef HARNESS_EGL
+    return (retro_proc_address_t)eglGetProcAddress(sym);
+#else
+    return (retro_proc_address_t)glfwGetProcAddress(sym);
 #endif
+}
+
+// Frontend callbacks. None of them carry user data, so find the calling
+// instance through the core's per-thread binding.
+static host_instance *current_instance(void) {
+    core_t *core = core_current();
+    return core ? (host_instance *)core_get_userdata(core) : NULL;
+}
 
-    // Create window
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Simple Triangle", NULL, NULL);
-    if (!window) {
-        fprintf(stderr, "Failed to create GLFW window\n");
-        glfwTerminate();
-        return -1;
+static void host_log(enum retro_log_level level, const char *fmt, ...) {
+    if (level >= RETRO_LOG_ERROR)
+        atomic_fetch_add_i32(&error_logs, 1);
+    if (!log_enabled && level < RETRO_LOG_WARN)
+        return;
+    va_list args;
+    va_start(args, fmt);
+    if (log_enabled) {
+        slock_lock(log_lock);
+        vfprintf(log_sink, fmt, args);
+        slock_unlock(log_lock);
+    } else {
+        vfprintf(stderr, fmt, args);
     }
+    va_end(args);
+}
 
-    // Set key callback and make context current
-    glfwSetKeyCallback(window, key_callback);
-    glfwMakeContextCurrent(window);
+static uintptr_t host_get_current_framebuffer(void) {
+    host_instance *inst = current_instance();
+    return inst ? inst->fbo : 0;
+}
 
-    // Initialize GLAD
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        fprintf(stderr, "Failed to initialize GLAD\n");
-        glfwDestroyWindow(window);
-        glfwTerminate();
-        return -1;
-    }
-
-    // Set viewport
-    glViewport(0, 0, 800, 600);
-
-    // Create and compile vertex shader
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_src, NULL);
-    glCompileShader(vertex_shader);
-    GLint success;
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char info_log[512];
-        glGetShaderInfoLog(vertex_shader, 512, NULL, info_log);
-        fprintf(stderr, "Vertex shader compilation failed: %s\n", info_log);
-        glfwDestroyWindow(window);
-        glfwTerminate();
-        return -1;
-    }
-
-    // Create and compile fragment shader
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_src, NULL);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char info_log[512];
-        glGetShaderInfoLog(fragment_shader, 512, NULL, info_log);
-        fprintf(stderr, "Fragment shader compilation failed: %s\n", info_log);
-        glfwDestroyWindow(window);
-        glfwTerminate();
-        return -1;
-    }
-
-    // Create shader program
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-    if (!success) {
-        char info_log[512];
-        glGetProgramInfoLog(shader_program, 512, NULL, info_log);
-        fprintf(stderr, "Shader program linking failed: %s\n", info_log);
-        glfwDestroyWindow(window);
-        glfwTerminate();
-        return -1;
-    }
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
-
-    // Set up VAO and VBO
-    GLuint vao, vbo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-
-    // Render loop
-    while (!glfwWindowShouldClose(window)) {
-        // Clear screen
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        // Draw triangle
-        glUseProgram(shader_program);
-        glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        glBindVertexArray(0);
-
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
-
-    // Cleanup
-    glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vbo);
-    glDeleteProgram(shader_program);
-    glfwDestroyWindow(window);
-    glfwTerminate();
+static bool host_environment(unsigned cmd, void *data) {
+    host_instance *inst = current_instance();
+    switch (cmd) {
+    case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+        ((struct retro_log_callback *)data)->log = host_log;
+        return true;
+    case RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME:
+    case RETRO_ENVIRONMENT_SET_VARIABLES:
+        return true;
+    case RETRO_ENVIRONMENT_GET_VARIABLE: {
+        struct retro_variable *var = (struct retro_variable *)data;
+        unsigned i;
+        var->value = NULL;
+        for (i = 0; i < option_count; i++) {
+            if (!strcmp(options[i].key, var->key)) {
+                var->value = options[i].value;
+                return true;
+            }
+        }
+        return false;
+    }
+    case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+        *(bool *)data = atomic_exchange_i32(&options_updated, 0) != 0;
+        return true;
+    case RETRO_ENVIRONMENT_GET_PREFERRED_HW_RENDER:
+        *(unsigned *)data = no_hw ? RETRO_HW_CONTEXT_NONE
+                : use_gles ? RETRO_HW_CONTEXT_OPENGLES3 : RETRO_HW_CONTEXT_OPENGL_CORE;
+        return true;
+    case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+        return *(const enum retro_pixel_format *)data == RETRO_PIXEL_FORMAT_XRGB8888;
+    case RETRO_ENVIRONMENT_SET_HW_RENDER: {
+        struct retro_hw_render_callback *hw = (struct retro_hw_render_callback *)data;
+        if (!inst || no_hw || hw->context_type != (use_gles ? RETRO_HW_CONTEXT_OPENGLES3 : RETRO_HW_CONTEXT_OPENGL_CORE))
+            return false;
+        hw->get_current_framebuffer = host_get_current_framebuffer;
+        hw->get_proc_address = harness_get_proc_address;
+        inst->hw_render = hw;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static void host_video_refresh(const void *data, unsigned width, unsigned height, size_t pitch) {
+    host_instance *inst = current_instance();
+    (void)width; (void)height;
+    if (inst) {
+        if (!inst->first_present)
+            inst->first_present = harness_time_usec();
+        if (data != RETRO_HW_FRAME_BUFFER_VALID) {
+            inst->frame = data;
+            inst->frame_pitch = pitch;
+        }
+        inst->frames++;
+    }
+}
+
+// Offline frames arrive here; touch one word per row so the readback
+// is really consumed
+static void host_frame_sink(void *user, const void *pixels, unsigned width,
+                            unsigned height, size_t pitch, uint64_t frame_index) {
+    host_instance *inst = (host_instance *)user;
+    const uint8_t *row = (const uint8_t *)pixels;
+    unsigned y;
+    (void)width; (void)frame_index;
+    for (y = 0; y < height; y++, row += pitch)
+        inst->sink_checksum = inst->sink_checksum * 31u + *(const uint32_t *)row;
+    inst->sink_frames++;
+}
+
+static void host_input_poll(void) {}
+
+static int16_t host_input_state(unsigned port, unsigned device, unsigned index, unsigned id) {
+    (void)port; (void)device; (void)index; (void)id;
     return 0;
-}
\ No newline at end of file
+}
+
+// Frontend-owned render target, like RetroArch's HW render FBO
+static bool create_framebuffer(host_instance *inst) {
+    glGenTextures(1, &inst->color_tex);
+    glBindTexture(GL_TEXTURE_2D, inst->color_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, HW_WIDTH, HW_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &inst->depth_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, inst->depth_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, HW_WIDTH, HW_HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &inst->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, inst->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, inst->color_tex, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, inst->depth_rb);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void destroy_framebuffer(host_instance *inst) {
+    glDeleteFramebuffers(1, &inst->fbo);
+    glDeleteRenderbuffers(1, &inst->depth_rb);
+    glDeleteTextures(1, &inst->color_tex);
+    inst->fbo = inst->depth_rb = inst->color_tex = 0;
+}
+
+// Bring up an instance on the calling thread with its context current,
+// recording when each libretro step finished if marks is non-NULL
+static bool instance_start(host_instance *inst, startup_marks *marks) {
+    startup_marks local;
+    if (!marks)
+        marks = &local;
+    context_make_current(&inst->ctx);
+    if (!create_framebuffer(inst)) {
+        fprintf(stderr, "Failed to create harness framebuffer\n");
+        return false;
+    }
+    marks->start = harness_time_usec();
+    inst->core = core_create();
+    if (!inst->core)
+        return false;
+    core_set_userdata(inst->core, inst);
+    core_set_environment(inst->core, host_environment);
+    core_set_video_refresh(inst->core, host_video_refresh);
+    core_set_input_poll(inst->core, host_input_poll);
+    core_set_input_state(inst->core, host_input_state);
+    marks->environment = harness_time_usec();
+    core_init(inst->core);
+    marks->init = harness_time_usec();
+    if (!core_load_game(inst->core, NULL) || (!inst->hw_render && !no_hw)) {
+        fprintf(stderr, "core_load_game failed\n");
+        return false;
+    }
+    marks->load_game = harness_time_usec();
+    if (inst->hw_render)
+        inst->hw_render->context_reset();
+    marks->context_reset = harness_time_usec();
+    return true;
+}
+
+static void instance_stop(host_instance *inst) {
+    if (inst->core) {
+        if (inst->hw_render)
+            inst->hw_render->context_destroy();
+        core_unload_game(inst->core);
+        core_deinit(inst->core);
+        core_destroy(inst->core);
+        inst->core = NULL;
+    }
+    destroy_framebuffer(inst);
+    context_make_current(NULL);
+}
+
+// Benchmark thread: start the instance, wait for the common start signal,
+// then run frames until told to stop.
+static void instance_thread(void *userdata) {
+    host_instance *inst = (host_instance *)userdata;
+    inst->ok = instance_start(inst, NULL);
+    atomic_fetch_add_i32(&ready_count, 1);
+    while (!atomic_load_i32(&start_flag))
+        retro_sleep(1);
+
+    int64_t start = harness_time_usec();
+    inst->frames = 0;
+    if (inst->ok) {
+        while (!atomic_load_i32(&stop_flag))
+            core_run(inst->core);
+        glFinish();
+    }
+    inst->seconds = (harness_time_usec() - start) / 1000000.0;
+    instance_stop(inst);
+}
+
+typedef struct bench_result {
+    double aggregate_fps;
+    double min_fps, max_fps;
+} bench_result;
+
+static void accumulate_fps(bench_result *result, double fps) {
+    result->aggregate_fps += fps;
+    if (fps < result->min_fps)
+        result->min_fps = fps;
+    if (fps > result->max_fps)
+        result->max_fps = fps;
+}
+
+// K instances, each with its own context and thread, in this process
+static bool bench_threads(host_instance *instances, unsigned count, double seconds, bench_result *result) {
+    unsigned i;
+    for (i = 0; i < count; i++) {
+        memset(&instances[i], 0, sizeof(instances[i]));
+        if (!context_create(&instances[i].ctx)) {
+            fprintf(stderr, "Failed to create context %u\n", i);
+            count = i;
+            break;
+        }
+    }
+    if (count == 0)
+        return false;
+
+    atomic_store_i32(&ready_count, 0);
+    atomic_store_i32(&start_flag, 0);
+    atomic_store_i32(&stop_flag, 0);
+    for (i = 0; i < count; i++)
+        instances[i].thread = sthread_create(instance_thread, &instances[i]);
+    while ((unsigned)atomic_load_i32(&ready_count) < count)
+        retro_sleep(1);
+
+    atomic_store_i32(&start_flag, 1);
+    retro_sleep((unsigned)(seconds * 1000.0));
+    atomic_store_i32(&stop_flag, 1);
+
+    bool ok = true;
+    result->aggregate_fps = 0.0;
+    result->min_fps = 1e30;
+    result->max_fps = 0.0;
+    for (i = 0; i < count; i++) {
+        sthread_join(instances[i].thread);
+        context_destroy(&instances[i].ctx);
+        ok = ok && instances[i].ok;
+        accumulate_fps(result, instances[i].seconds > 0.0 ? instances[i].frames / instances[i].seconds : 0.0);
+    }
+    return ok;
+}
+
+// K single-instance child processes running concurrently
+static bool bench_processes(const char *self, unsigned count, double seconds, bench_result *result) {
+    FILE *children[MAX_INSTANCES];
+    char command[1024];
+    unsigned i;
+    snprintf(command, sizeof(command), "\"%s\" shard %f%s%s", self, seconds, use_gles ? " --gles" : "",
+             no_hw ? " --no-hw" : "");
+    for (i = 0; i < count; i++)
+        children[i] = popen(command, "r");
+
+    bool ok = true;
+    result->aggregate_fps = 0.0;
+    result->min_fps = 1e30;
+    result->max_fps = 0.0;
+    for (i = 0; i < count; i++) {
+        double fps = 0.0;
+        char line[256];
+        if (!children[i]) {
+            ok = false;
+            continue;
+        }
+        while (fgets(line, sizeof(line), children[i]))
+            sscanf(line, "fps=%lf", &fps);
+        if (pclose(children[i]) != 0 || fps <= 0.0)
+            ok = false;
+        accumulate_fps(result, fps);
+    }
+    return ok;
+}
+
+static void print_result(const char *mode, unsigned count, const bench_result *result, double base_fps) {
+    double efficiency = base_fps > 0.0 ? result->aggregate_fps / (base_fps * count) : 0.0;
+    printf("%-9s %4u %14.1f %10.1f %10.1f %10.1f %9.0f%%\n", mode, count, result->aggregate_fps,
+           result->min_fps, result->aggregate_fps / count, result->max_fps, efficiency * 100.0);
+    fflush(stdout);
+}
+
+static int cmd_bench(const char *self, unsigned max_instances, double seconds, bool threads, bool processes) {
+    static host_instance instances[MAX_INSTANCES];
+    double thread_base = 0.0, process_base = 0.0;
+    unsigned k;
+
+    printf("%-9s %4s %14s %10s %10s %10s %10s\n", "mode", "K", "aggregate_fps",
+           "min_fps", "avg_fps", "max_fps", "scaling");
+    for (k = 1; k <= max_instances; k++) {
+        bench_result result;
+        if (threads) {
+            if (!bench_threads(instances, k, seconds, &result))
+                fprintf(stderr, "Thread round K=%u had failing instances\n", k);
+            if (k == 1)
+                thread_base = result.aggregate_fps;
+            print_result("threads", k, &result, thread_base);
+        }
+        if (processes) {
+            if (!bench_processes(self, k, seconds, &result))
+                fprintf(stderr, "Process round K=%u had failing instances\n", k);
+            if (k == 1)
+                process_base = result.aggregate_fps;
+            print_result("processes", k, &result, process_base);
+        }
+    }
+    return 0;
+}
+
+// One instance on the main thread
+static int cmd_run(unsigned frames, double seconds) {
+    host_instance inst;
+    memset(&inst, 0, sizeof(inst));
+    if (!context_create(&inst.ctx)) {
+        fprintf(stderr, "Failed to create OpenGL context\n");
+        return 1;
+    }
+    if (!instance_start(&inst, NULL)) {
+        instance_stop(&inst);
+        context_destroy(&inst.ctx);
+        return 1;
+    }
+
+    core_alloc_stats warm, done;
+    memset(&warm, 0, sizeof(warm));
+    int64_t start = harness_time_usec();
+    int64_t deadline = start + (int64_t)(seconds * 1000000.0);
+    while (frames ? inst.frames < frames : harness_time_usec() < deadline) {
+        core_run(inst.core);
+        if (inst.frames == WARMUP_FRAMES)
+            core_alloc_get_stats(&warm);
+    }
+    glFinish();
+    double elapsed = (harness_time_usec() - start) / 1000000.0;
+
+    unsigned char pixel[4] = { 0 };
+    if (inst.frame) {
+        // Software frames are top row first; pick the texel GL reads below
+        uint32_t xrgb = ((const uint32_t *)((const uint8_t *)inst.frame +
+                (HW_HEIGHT - 1 - HW_HEIGHT / 2) * inst.frame_pitch))[HW_WIDTH / 2];
+        pixel[0] = (unsigned char)(xrgb >> 16);
+        pixel[1] = (unsigned char)(xrgb >> 8);
+        pixel[2] = (unsigned char)xrgb;
+        pixel[3] = 255;
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, inst.fbo);
+        glReadPixels(HW_WIDTH / 2, HW_HEIGHT / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    printf("frames=%u\n", inst.frames);
+    printf("fps=%f\n", elapsed > 0.0 ? inst.frames / elapsed : 0.0);
+    printf("center_pixel=%u,%u,%u,%u\n", pixel[0], pixel[1], pixel[2], pixel[3]);
+
+    // Per-frame averages; latency is what the pipeline depth costs in input lag
+    pipeline_stats stats;
+    core_get_pipeline_stats(inst.core, &stats);
+    if (stats.frames) {
+        printf("pipeline_latency_frames=%u\n", stats.latency_frames);
+        printf("sim_ms=%.3f\n", stats.sim_usec / 1000.0 / stats.frames);
+        printf("submit_ms=%.3f\n", stats.submit_usec / 1000.0 / stats.frames);
+        printf("stall_ms=%.3f\n", stats.stall_usec / 1000.0 / stats.frames);
+        printf("arena_high_water=%lu\n", (unsigned long)stats.arena_high_water);
+    }
+
+    gpu_caps caps;
+    core_get_gpu_caps(inst.core, &caps);
+    printf("gl_tier=%s\n", gpu_tier_name(caps.tier));
+    printf("gl_features=%s%s%s%s\n", caps.direct_state_access ? "dsa," : "", caps.buffer_storage ? "buffer_storage," : "",
+           caps.multi_draw_indirect ? "mdi," : "", caps.invalidate_subdata ? "invalidate," : "");
+
+    render_stats rstats;
+    core_get_render_stats(inst.core, &rstats);
+    if (rstats.frames) {
+        printf("commands_per_frame=%.1f\n", (double)rstats.commands / rstats.frames);
+        printf("draws_per_frame=%.1f\n", (double)rstats.draws / rstats.frames);
+        printf("opaque_draws_per_frame=%.1f\n", (double)rstats.opaque_draws / rstats.frames);
+        printf("tile_chunks_per_frame=%.1f\n", (double)rstats.tile_chunks / rstats.frames);
+        printf("instances_per_frame=%.1f\n", (double)rstats.instances / rstats.frames);
+        printf("state_changes_per_frame=%.1f\n", (double)rstats.state_changes / rstats.frames);
+        printf("tessellations=%llu\n", (unsigned long long)rstats.tessellations);
+        printf("indirect_draws_per_frame=%.1f\n", (double)rstats.indirect_draws / rstats.frames);
+        printf("debug_dropped=%llu\n", (unsigned long long)rstats.debug_dropped);
+        printf("passes_per_frame=%.1f\n", (double)rstats.passes / rstats.frames);
+        printf("culled_passes_per_frame=%.1f\n", (double)rstats.culled_passes / rstats.frames);
+        printf("render_targets=%llu\n", (unsigned long long)rstats.render_targets);
+        static const char *const post_stage_names[POST_STAGES] = { "bloom", "blur", "composite" };
+        for (unsigned s = 0; s < POST_STAGES; s++)
+            if (rstats.post_gpu_samples[s])
+                printf("%s_gpu_ms=%.3f\n", post_stage_names[s],
+                       rstats.post_gpu_ns[s] / 1e6 / rstats.post_gpu_samples[s]);
+    }
+
+    // Steady-state frames must not touch the heap
+    bool heap_ok = true;
+    if (inst.frames > WARMUP_FRAMES) {
+        core_alloc_get_stats(&done);
+        int64_t allocs = done.allocs - warm.allocs;
+        printf("heap_allocs_after_warmup=%lld\n", (long long)allocs);
+        if (allocs) {
+            fprintf(stderr, "FAIL: %lld heap allocations in %u frames after warm-up\n",
+                    (long long)allocs, inst.frames - WARMUP_FRAMES);
+            heap_ok = false;
+        }
+    }
+    instance_stop(&inst);
+    context_destroy(&inst.ctx);
+    return inst.frames > 0 && heap_ok ? 0 : 1;
+}
+
+static void set_option(const char *key, const char *value) {
+    unsigned i;
+    for (i = 0; i < option_count; i++)
+        if (!strcmp(options[i].key, key))
+            break;
+    if (i == MAX_OPTIONS)
+        return;
+    snprintf(options[i].key, sizeof(options[i].key), "%s", key);
+    snprintf(options[i].value, sizeof(options[i].value), "%s", value);
+    if (i == option_count)
+        option_count++;
+}
+
+// Uncapped offline rendering: frames stream out through the frame sink
+static int cmd_offline(double seconds, unsigned frames_per_run) {
+    host_instance inst;
+    char frames_value[16];
+    memset(&inst, 0, sizeof(inst));
+    snprintf(frames_value, sizeof(frames_value), "%u", frames_per_run);
+    set_option("glad_core_offline_render", "enabled");
+    set_option("glad_core_offline_frames_per_run", frames_value);
+
+    if (!context_create(&inst.ctx)) {
+        fprintf(stderr, "Failed to create OpenGL context\n");
+        return 1;
+    }
+    if (!instance_start(&inst, NULL)) {
+        instance_stop(&inst);
+        context_destroy(&inst.ctx);
+        return 1;
+    }
+    core_set_frame_sink(inst.core, host_frame_sink, &inst);
+
+    int64_t start = harness_time_usec();
+    int64_t deadline = start + (int64_t)(seconds * 1000000.0);
+    unsigned runs = 0;
+    while (harness_time_usec() < deadline) {
+        core_run(inst.core);
+        runs++;
+    }
+    // Tearing down the context drains the readback ring into the sink
+    if (inst.hw_render)
+        inst.hw_render->context_destroy();
+    inst.hw_render = NULL;
+    double elapsed = (harness_time_usec() - start) / 1000000.0;
+
+    printf("runs=%u\n", runs);
+    printf("frames=%llu\n", (unsigned long long)inst.sink_frames);
+    printf("fps=%f\n", elapsed > 0.0 ? inst.sink_frames / elapsed : 0.0);
+    printf("checksum=%08x\n", inst.sink_checksum);
+    instance_stop(&inst);
+    context_destroy(&inst.ctx);
+    return inst.sink_frames > 0 ? 0 : 1;
+}
+
+// Options reconfigure toggles, each off and back on, while frames are queued
+static const host_option reconfigure_steps[][2] = {
+    { { "glad_core_vector_art", "disabled" }, { "glad_core_vector_art", "enabled" } },
+    { { "glad_core_text_hud", "disabled" }, { "glad_core_text_hud", "enabled" } },
+    { { "glad_core_tilemap", "disabled" }, { "glad_core_tilemap", "enabled" } },
+    { { "glad_core_particle_count", "0" }, { "glad_core_particle_count", "10000" } },
+    { { "glad_core_entity_count", "0" }, { "glad_core_entity_count", "1000" } },
+    { { "glad_core_debug_overlay", "disabled" }, { "glad_core_debug_overlay", "enabled" } },
+    { { "glad_core_bloom", "disabled" }, { "glad_core_bloom", "enabled" } },
+    { { "glad_core_job_threads", "0" }, { "glad_core_job_threads", "2" } },
+    { { "glad_core_job_affinity", "enabled" }, { "glad_core_job_affinity", "disabled" } },
+    { { "glad_core_pipeline_depth", "1" }, { "glad_core_pipeline_depth", "3" } },
+};
+
+// Runtime option changes with a full pipeline: every feature starts on at
+// depth 3, then each option is flipped every few frames. Fails if the core
+// logs an error or stops presenting.
+static int cmd_reconfigure(unsigned frames) {
+    const unsigned count = sizeof(reconfigure_steps) / sizeof(reconfigure_steps[0]);
+    const unsigned interval = 8; // Frames between changes, enough to refill the queue
+    host_instance inst;
+    unsigned i, changes = 0;
+    memset(&inst, 0, sizeof(inst));
+    set_option("glad_core_pipeline_depth", "3");
+    set_option("glad_core_job_threads", "2");
+    for (i = 0; i < count; i++)
+        set_option(reconfigure_steps[i][1].key, reconfigure_steps[i][1].value);
+
+    if (!context_create(&inst.ctx)) {
+        fprintf(stderr, "Failed to create OpenGL context\n");
+        return 1;
+    }
+    if (!instance_start(&inst, NULL)) {
+        instance_stop(&inst);
+        context_destroy(&inst.ctx);
+        return 1;
+    }
+
+    for (i = 1; i <= frames; i++) {
+        if (i % interval == 0) {
+            const host_option *step = &reconfigure_steps[changes / 2 % count][changes % 2];
+            set_option(step->key, step->value);
+            atomic_store_i32(&options_updated, 1);
+            changes++;
+        }
+        core_run(inst.core);
+    }
+    glFinish();
+
+    int errors = atomic_load_i32(&error_logs);
+    printf("frames=%u\n", inst.frames);
+    printf("option_changes=%u\n", changes);
+    printf("errors=%d\n", errors);
+    if (errors)
+        fprintf(stderr, "FAIL: core logged %d error(s) across %u option changes\n", errors, changes);
+    if (inst.frames != frames)
+        fprintf(stderr, "FAIL: %u of %u frames presented\n", inst.frames, frames);
+    instance_stop(&inst);
+    context_destroy(&inst.ctx);
+    return inst.frames == frames && !errors ? 0 : 1;
+}
+
+// Startup phases, in the order a frontend goes through them
+enum startup_phase {
+    PHASE_CONTEXT,         // Host: GL context and framebuffer (not the core's cost)
+    PHASE_ENVIRONMENT,     // core_create and the set_* callbacks (retro_set_environment)
+    PHASE_INIT,            // retro_init
+    PHASE_LOAD_GAME,       // retro_load_game
+    PHASE_CONTEXT_RESET,   // context_reset, all of it
+    PHASE_GL_LOAD,         // ... of which loading entry points
+    PHASE_SHADERS,         // ... of which compiling and linking
+    PHASE_GL_SETUP,        // ... of which everything else (buffers, VAOs, textures)
+    PHASE_FIRST_RUN,       // First retro_run up to video_cb
+    PHASE_FIRST_FRAME_GPU, // After video_cb until the GPU finished that frame
+    PHASE_TOTAL,           // retro_set_environment to the first video_cb
+    PHASE_GL_LOOKUPS,      // Counts, not times
+    PHASE_PROGRAMS,
+    STARTUP_PHASES
+};
+
+static const char *const startup_phase_names[STARTUP_PHASES] = {
+    "host_context_ms", "set_environment_ms", "init_ms", "load_game_ms", "context_reset_ms", "gl_load_ms",
+    "shader_compile_ms", "gl_setup_ms", "first_run_ms", "first_frame_gpu_ms", "total_ms", "gl_lookups", "programs"
+};
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_json_string(const char *s) {
+    putchar('"');
+    for (; s && *s; s++) {
+        if (*s == '"' || *s == '\\')
+            printf("\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            printf("\\u%04x", (unsigned char)*s);
+        else
+            putchar(*s);
+    }
+    putchar('"');
+}
+
+static void print_startup_phases(const char *name, const double *phases, unsigned samples, bool last) {
+    unsigned p;
+    printf("  \"%s\": {\n    \"samples\": %u", name, samples);
+    for (p = 0; p < STARTUP_PHASES; p++) {
+        if (p >= PHASE_GL_LOOKUPS)
+            printf(",\n    \"%s\": %.0f", startup_phase_names[p], phases[p]);
+        else
+            printf(",\n    \"%s\": %.3f", startup_phase_names[p], phases[p]);
+    }
+    printf("\n  }%s\n", last ? "" : ",");
+}
+
+// Start the core from nothing to its first presented frame, runs times in
+// one process, and print where the time went as JSON. The first run is
+// cold: nothing loaded or compiled by this process yet. The rest are warm,
+// like a frontend restarting the core, and are reported as medians.
+static int cmd_startup(unsigned runs) {
+    static double samples[STARTUP_PHASES][MAX_STARTUP_RUNS];
+    double cold[STARTUP_PHASES], warm[STARTUP_PHASES];
+    char renderer[128] = "", version[128] = "";
+    unsigned r, p;
+
+    if (runs > MAX_STARTUP_RUNS)
+        runs = MAX_STARTUP_RUNS;
+    for (r = 0; r < runs; r++) {
+        host_instance inst;
+        startup_marks marks;
+        startup_stats stats;
+        memset(&inst, 0, sizeof(inst));
+
+        int64_t begin = harness_time_usec();
+        if (!context_create(&inst.ctx)) {
+            fprintf(stderr, "Failed to create OpenGL context\n");
+            return 1;
+        }
+        if (!instance_start(&inst, &marks)) {
+            instance_stop(&inst);
+            context_destroy(&inst.ctx);
+            return 1;
+        }
+        int64_t run_start = harness_time_usec();
+        core_run(inst.core);
+        if (!inst.first_present) {
+            fprintf(stderr, "First retro_run presented nothing\n");
+            instance_stop(&inst);
+            context_destroy(&inst.ctx);
+            return 1;
+        }
+        glFinish();
+        int64_t finished = harness_time_usec();
+        core_get_startup_stats(inst.core, &stats);
+        if (r == 0) {
+            snprintf(renderer, sizeof(renderer), "%s", (const char *)glGetString(GL_RENDERER));
+            snprintf(version, sizeof(version), "%s", (const char *)glGetString(GL_VERSION));
+        }
+        instance_stop(&inst);
+        context_destroy(&inst.ctx);
+
+        double reset = (marks.context_reset - marks.load_game) / 1000.0;
+        double gl_load = stats.gl_load_usec / 1000.0, shaders = stats.shader_usec / 1000.0;
+        double phases[STARTUP_PHASES] = {
+            (marks.start - begin) / 1000.0,
+            (marks.environment - marks.start) / 1000.0,
+            (marks.init - marks.environment) / 1000.0,
+            (marks.load_game - marks.init) / 1000.0,
+            reset, gl_load, shaders,
+            reset - gl_load - shaders > 0.0 ? reset - gl_load - shaders : 0.0,
+            (inst.first_present - run_start) / 1000.0,
+            (finished - inst.first_present) / 1000.0,
+            (inst.first_present - marks.start) / 1000.0,
+            stats.gl_lookups, stats.programs
+        };
+        for (p = 0; p < STARTUP_PHASES; p++)
+            samples[p][r] = phases[p];
+    }
+
+    for (p = 0; p < STARTUP_PHASES; p++) {
+        cold[p] = samples[p][0];
+        warm[p] = 0.0;
+        if (runs > 1) {
+            qsort(&samples[p][1], runs - 1, sizeof(double), compare_double);
+            warm[p] = samples[p][1 + (runs - 1) / 2];
+        }
+    }
+
+    printf("{\n  \"benchmark\": \"startup\",\n  \"renderer\": ");
+    print_json_string(renderer);
+    printf(",\n  \"version\": ");
+    print_json_string(version);
+    printf(",\n  \"options\": {");
+    for (p = 0; p < option_count; p++) {
+        printf(p ? ", " : "");
+        print_json_string(options[p].key);
+        printf(": ");
+        print_json_string(options[p].value);
+    }
+    printf("},\n  \"runs\": %u,\n", runs);
+    print_startup_phases("cold", cold, 1, runs < 2);
+    if (runs > 1)
+        print_startup_phases("warm", warm, runs - 1, true);
+    printf("}\n");
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *command = argc > 1 ? argv[1] : "run";
+    bool threads = true, processes = true;
+    unsigned positional[2] = { 0, 0 };
+    unsigned npositional = 0;
+    int i;
+
+#if defined(__GLIBC__)
+    alloc_interposer_init();
+#endif
+
+    for (i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "--log")) {
+            log_enabled = true;
+        } else if (!strcmp(argv[i], "--gles")) {
+            use_gles = true;
+        } else if (!strcmp(argv[i], "--no-hw")) {
+            no_hw = true;
+        } else if (!strcmp(argv[i], "--option") && i + 1 < argc) {
+            char key[64];
+            const char *eq = strchr(argv[++i], '=');
+            if (eq && eq - argv[i] < (int)sizeof(key)) {
+                memcpy(key, argv[i], eq - argv[i]);
+                key[eq - argv[i]] = '\0';
+                set_option(key, eq + 1);
+            }
+        }
+        else if (!strcmp(argv[i], "--threads-only"))
+            processes = false;
+        else if (!strcmp(argv[i], "--processes-only"))
+            threads = false;
+        else if (npositional < 2)
+            positional[npositional++] = (unsigned)atof(argv[i]);
+    }
+
+    if (log_enabled) {
+        log_lock = slock_new();
+        log_sink = fopen("harness.log", "w");
+        if (!log_sink)
+            log_sink = stderr;
+    }
+    if (!context_platform_init())
+        return 1;
+
+    // Load glad once on the main thread; every context shares the driver
+    harness_context loader_ctx;
+    if (!context_create(&loader_ctx)) {
+        fprintf(stderr, "Failed to create OpenGL context\n");
+        context_platform_shutdown();
+        return 1;
+    }
+    context_make_current(&loader_ctx);
+    if (!gladLoadGLLoader((GLADloadproc)harness_get_proc_address)) {
+        fprintf(stderr, "Failed to initialize GLAD\n");
+        context_platform_shutdown();
+        return 1;
+    }
+    context_make_current(NULL);
+    context_destroy(&loader_ctx);
+
+    int ret = 0;
+    if (!strcmp(command, "run")) {
+        ret = cmd_run(positional[0] ? positional[0] : 600, 0.0);
+    } else if (!strcmp(command, "shard")) {
+        ret = cmd_run(0, argc > 2 ? atof(argv[2]) : 5.0);
+    } else if (!strcmp(command, "offline")) {
+        ret = cmd_offline(positional[0] ? positional[0] : 5.0, positional[1] ? positional[1] : 16);
+    } else if (!strcmp(command, "reconfigure")) {
+        ret = cmd_reconfigure(positional[0] ? positional[0] : 240);
+    } else if (!strcmp(command, "startup")) {
+        ret = cmd_startup(positional[0] ? positional[0] : 8);
+    } else if (!strcmp(command, "bench")) {
+        unsigned max_instances = positional[0] ? positional[0] : harness_cpu_count();
+        if (max_instances > MAX_INSTANCES)
+            max_instances = MAX_INSTANCES;
+        ret = cmd_bench(argv[0], max_instances, positional[1] ? positional[1] : 5.0, threads, processes);
+    } else {
+        fprintf(stderr, "Unknown command '%s' (expected run, offline, startup, reconfigure, bench or shard)\n", command);
+        ret = 1;
+    }
+
+    context_platform_shutdown();
+    if (log_sink && log_sink != stderr)
+        fclose(log_sink);
+    if (log_lock)
+        slock_free(log_lock);
+    return ret;
+}
@@ -0,0 +1,231 @@
+#include "particles.h"
+#include "core.h"
+#include <string.h>
+
+// Per-particle state, interleaved: position, velocity, (age, life). A
+// negative age is a particle not yet born; seeding staggers ages so the
+// emitter starts in a steady stream instead of one burst.
+#define PARTICLE_STRIDE (6 * sizeof(float))
+
+static const char *update_vertex_shader_src =
+   "#version 330 core\n"
+   "layout(location = 0) in vec2 in_pos;\n"
+   "layout(location = 1) in vec2 in_vel;\n"
+   "layout(location = 2) in vec2 in_age_life;\n"
+   "out vec2 out_pos;\n"
+   "out vec2 out_vel;\n"
+   "out vec2 out_age_life;\n"
+   "uniform float dt;\n"
+   "uniform float time;\n"
+   "uniform bool reset;\n"
+   "uniform vec2 emitter;\n"
+   "uniform float direction;\n"
+   "uniform float spread;\n"
+   "uniform float speed;\n"
+   "uniform float lifetime;\n"
+   "uniform float gravity;\n"
+   "float hash(uint x) {\n"
+   "   x ^= x >> 16; x *= 0x7feb352du;\n"
+   "   x ^= x >> 15; x *= 0x846ca68bu;\n"
+   "   x ^= x >> 16;\n"
+   "   return float(x) * (1.0 / 4294967296.0);\n"
+   "}\n"
+   "void main() {\n"
+   "   uint id = uint(gl_VertexID);\n"
+   "   if (reset) {\n"
+   "      out_pos = emitter;\n"
+   "      out_vel = vec2(0.0);\n"
+   "      out_age_life = vec2(-hash(id) * lifetime, lifetime);\n"
+   "      return;\n"
+   "   }\n"
+   "   vec2 pos = in_pos, vel = in_vel;\n"
+   "   float age = in_age_life.x + dt, life = in_age_life.y;\n"
+   "   if (age >= life) {\n"
+   "      uint seed = id * 3u + floatBitsToUint(time) * 0x9e3779b9u;\n"
+   "      float angle = direction + (hash(seed) - 0.5) * spread;\n"
+   "      pos = emitter;\n"
+   "      vel = vec2(cos(angle), sin(angle)) * speed * (0.25 + 0.75 * hash(seed + 1u));\n"
+   "      age = min(age - life, dt);\n"
+   "      life = lifetime * (0.5 + 0.5 * hash(seed + 2u));\n"
+   "   } else if (age >= 0.0) {\n"
+   "      vel.y += gravity * dt;\n"
+   "      pos += vel * dt;\n"
+   "   }\n"
+   "   out_pos = pos;\n"
+   "   out_vel = vel;\n"
+   "   out_age_life = vec2(age, life);\n"
+   "}\n";
+
+static const char *const update_varyings[] = { "out_pos", "out_vel", "out_age_life" };
+
+// Same pixel-to-clip mapping as quad_batch; unborn particles are moved
+// outside the clip volume
+static const char *render_vertex_shader_src =
+   "#version 330 core\n"
+   "layout(location = 0) in vec2 inst_pos;\n"
+   "layout(location = 1) in vec2 inst_age_life;\n"
+   "uniform vec2 viewport;\n"
+   "uniform vec2 camera;\n"
+   "uniform float size;\n"
+   "uniform float depth;\n"
+   "uniform vec4 color;\n"
+   "out vec4 v_color;\n"
+   "out vec2 v_uv;\n"
+   "void main() {\n"
+   "   vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));\n"
+   "   float age = inst_age_life.x, life = inst_age_life.y;\n"
+   "   if (age < 0.0) {\n"
+   "      gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+   "      return;\n"
+   "   }\n"
+   "   vec2 pixel = inst_pos - camera + (corner - 0.5) * size;\n"
+   "   gl_Position = vec4(pixel.x / viewport.x * 2.0 - 1.0, 1.0 - pixel.y / viewport.y * 2.0, depth * 2.0 - 1.0, 1.0);\n"
+   "   v_color = vec4(color.rgb, color.a * (1.0 - age / life));\n"
+   "   v_uv = corner * 2.0 - 1.0;\n"
+   "}\n";
+
+static const char *render_fragment_shader_src =
+   "#version 330 core\n"
+   "in vec4 v_color;\n"
+   "in vec2 v_uv;\n"
+   "out vec4 frag_color;\n"
+   "void main() {\n"
+   "   float falloff = 1.0 - smoothstep(0.5, 1.0, length(v_uv));\n"
+   "   frag_color = vec4(v_color.rgb, v_color.a * falloff);\n"
+   "}\n";
+
+static void setup_vaos(particle_system *ps, unsigned i) {
+   glBindVertexArray(ps->update_vao[i]);
+   glBindBuffer(GL_ARRAY_BUFFER, ps->vbo[i]);
+   glEnableVertexAttribArray(0);
+   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, (void *)0);
+   glEnableVertexAttribArray(1);
+   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, (void *)(2 * sizeof(float)));
+   glEnableVertexAttribArray(2);
+   glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, (void *)(4 * sizeof(float)));
+
+   glBindVertexArray(ps->render_vao[i]);
+   glEnableVertexAttribArray(0);
+   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, (void *)0);
+   glVertexAttribDivisor(0, 1);
+   glEnableVertexAttribArray(1);
+   glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, PARTICLE_STRIDE, (void *)(4 * sizeof(float)));
+   glVertexAttribDivisor(1, 1);
+   glBindVertexArray(0);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool particle_system_init(core_t *core, particle_system *ps, unsigned count) {
+   unsigned i;
+   memset(ps, 0, sizeof(*ps));
+   if (!count)
+      return false;
+   ps->count = count;
+
+   ps->update_program = core_create_feedback_program(core, update_vertex_shader_src,
+         update_varyings, 3, "Particle update");
+   ps->render_program = core_create_shader_program(core, render_vertex_shader_src,
+         render_fragment_shader_src, "Particle render");
+   if (!ps->update_program || !ps->render_program) {
+      particle_system_deinit(ps);
+      return false;
+   }
+   ps->u_dt = glGetUniformLocation(ps->update_program, "dt");
+   ps->u_time = glGetUniformLocation(ps->update_program, "time");
+   ps->u_reset = glGetUniformLocation(ps->update_program, "reset");
+   ps->u_emitter = glGetUniformLocation(ps->update_program, "emitter");
+   ps->u_direction = glGetUniformLocation(ps->update_program, "direction");
+   ps->u_spread = glGetUniformLocation(ps->update_program, "spread");
+   ps->u_speed = glGetUniformLocation(ps->update_program, "speed");
+   ps->u_lifetime = glGetUniformLocation(ps->update_program, "lifetime");
+   ps->u_gravity = glGetUniformLocation(ps->update_program, "gravity");
+   ps->r_viewport = glGetUniformLocation(ps->render_program, "viewport");
+   ps->r_camera = glGetUniformLocation(ps->render_program, "camera");
+   ps->r_size = glGetUniformLocation(ps->render_program, "size");
+   ps->r_depth = glGetUniformLocation(ps->render_program, "depth");
+   ps->r_color = glGetUniformLocation(ps->render_program, "color");
+
+   // Storage only: the first update seeds it on the GPU
+   glGenBuffers(2, ps->vbo);
+   glGenVertexArrays(2, ps->update_vao);
+   glGenVertexArrays(2, ps->render_vao);
+   for (i = 0; i < 2; i++) {
+      glBindBuffer(GL_ARRAY_BUFFER, ps->vbo[i]);
+      glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)count * PARTICLE_STRIDE, NULL, GL_DYNAMIC_COPY);
+      setup_vaos(ps, i);
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   // Large counts can exhaust video memory; let the caller report it
+   if (glGetError() != GL_NO_ERROR) {
+      particle_system_deinit(ps);
+      return false;
+   }
+   return true;
+}
+
+void particle_system_deinit(particle_system *ps) {
+   if (ps->update_program)
+      glDeleteProgram(ps->update_program);
+   if (ps->render_program)
+      glDeleteProgram(ps->render_program);
+   if (ps->vbo[0])
+      glDeleteBuffers(2, ps->vbo);
+   if (ps->update_vao[0])
+      glDeleteVertexArrays(2, ps->update_vao);
+   if (ps->render_vao[0])
+      glDeleteVertexArrays(2, ps->render_vao);
+   memset(ps, 0, sizeof(*ps));
+}
+
+// One transform feedback pass from the current buffer into the other
+static void run_pass(particle_system *ps) {
+   unsigned next = ps->current ^ 1;
+   glBindVertexArray(ps->update_vao[ps->current]);
+   glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, ps->vbo[next]);
+   glBeginTransformFeedback(GL_POINTS);
+   glDrawArrays(GL_POINTS, 0, (GLsizei)ps->count);
+   glEndTransformFeedback();
+   glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+   ps->current = next;
+}
+
+void particle_system_update(particle_system *ps, const particle_emitter *emitter, float dt, float time) {
+   if (!ps->count)
+      return;
+   glUseProgram(ps->update_program);
+   glUniform1f(ps->u_dt, dt);
+   glUniform1f(ps->u_time, time);
+   glUniform2f(ps->u_emitter, emitter->x, emitter->y);
+   glUniform1f(ps->u_direction, emitter->direction);
+   glUniform1f(ps->u_spread, emitter->spread);
+   glUniform1f(ps->u_speed, emitter->speed);
+   glUniform1f(ps->u_lifetime, emitter->lifetime);
+   glUniform1f(ps->u_gravity, emitter->gravity);
+   glEnable(GL_RASTERIZER_DISCARD);
+   if (!ps->seeded) {
+      glUniform1i(ps->u_reset, 1);
+      run_pass(ps);
+      glUniform1i(ps->u_reset, 0);
+      ps->seeded = true;
+   }
+   run_pass(ps);
+   glDisable(GL_RASTERIZER_DISCARD);
+   glBindVertexArray(0);
+   glUseProgram(0);
+}
+
+void particle_system_draw(const particle_system *ps, const particle_emitter *emitter,
+      float cam_x, float cam_y, float vp_width, float vp_height, float depth) {
+   uint32_t c = emitter->color;
+   if (!ps->count || !ps->seeded)
+      return;
+   glUseProgram(ps->render_program);
+   glUniform2f(ps->r_viewport, vp_width, vp_height);
+   glUniform2f(ps->r_camera, cam_x, cam_y);
+   glUniform1f(ps->r_size, emitter->size);
+   glUniform1f(ps->r_depth, depth);
+   glUniform4f(ps->r_color, (c & 0xff) / 255.0f, ((c >> 8) & 0xff) / 255.0f,
+         ((c >> 16) & 0xff) / 255.0f, (c >> 24) / 255.0f);
+   glBindVertexArray(ps->render_vao[ps->current]);
+   glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)ps->count);
+}
@@ -0,0 +1,58 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+
+// Emission parameters, passed to the update shader as uniforms. Particles
+// whose life ends respawn at the emitter, so emission is continuous at
+// count / lifetime particles per second.
+typedef struct particle_emitter {
+   float x, y;        // World pixels
+   float direction;   // Mean launch angle, radians (0 = +x, pi/2 = down)
+   float spread;      // Launch cone width, radians
+   float speed;       // Maximum launch speed, pixels per second
+   float lifetime;    // Maximum life, seconds
+   float gravity;     // Downward acceleration, pixels per second squared
+   float size;        // Sprite size, pixels
+   uint32_t color;    // RGBA8; alpha fades out over each particle's life
+} particle_emitter;
+
+// Particles simulated entirely on the GPU. State lives in two VBOs; each
+// update runs a vertex-only program over one with rasterization off and
+// captures the result into the other through transform feedback, then
+// the two swap. Rendering draws one instanced quad per particle straight
+// from the current buffer. Apart from uniforms, the CPU never touches
+// particle data: there are no per-particle loops or per-frame uploads,
+// not even at startup, where a reset pass seeds the buffers.
+typedef struct particle_system {
+   unsigned count;
+   GLuint vbo[2];
+   GLuint update_vao[2]; // Reads vbo[i] as update input
+   GLuint render_vao[2]; // Reads vbo[i] as per-instance data
+   unsigned current;     // Buffer holding the latest state
+   bool seeded;
+
+   GLuint update_program, render_program;
+   GLint u_dt, u_time, u_reset, u_emitter, u_direction, u_spread, u_speed, u_lifetime, u_gravity;
+   GLint r_viewport, r_camera, r_size, r_depth, r_color;
+} particle_system;
+
+struct core;
+
+// Needs a current GL context
+bool particle_system_init(struct core *core, particle_system *ps, unsigned count);
+void particle_system_deinit(particle_system *ps);
+
+// Advance every particle by dt seconds. Leaves rasterization enabled and
+// nothing bound.
+void particle_system_update(particle_system *ps, const particle_emitter *emitter, float dt, float time);
+
+// Draw the current state as additive-friendly sprites seen from camera
+// (top-left of the view, world pixels) at window-space depth. Leaves the
+// render program and VAO bound.
+void particle_system_draw(const particle_system *ps, const particle_emitter *emitter,
+      float cam_x, float cam_y, float vp_width, float vp_height, float depth);
+
+#endif // PARTICLES_H
@@ -0,0 +1,158 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#endif
+#include "pipeline.h"
+#include "alloc.h"
+#include <string.h>
+#include <time.h>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+int64_t pipeline_time_usec(void) {
+#if defined(_WIN32)
+   static LARGE_INTEGER freq;
+   LARGE_INTEGER count;
+   if (!freq.QuadPart)
+      QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&count);
+   return (int64_t)(count.QuadPart * 1000000 / freq.QuadPart);
+#else
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+bool render_list_alloc_entities(render_list *list, unsigned count) {
+   size_t stream = (size_t)count * sizeof(float);
+   list->entity_count = 0;
+   list->x = (float *)frame_arena_alloc(&list->arena, stream);
+   list->y = (float *)frame_arena_alloc(&list->arena, stream);
+   list->w = (float *)frame_arena_alloc(&list->arena, stream);
+   list->h = (float *)frame_arena_alloc(&list->arena, stream);
+   list->color = (uint32_t *)frame_arena_alloc(&list->arena, (size_t)count * sizeof(uint32_t));
+   if (!list->x || !list->y || !list->w || !list->h || !list->color)
+      return false;
+   list->entity_count = count;
+   return true;
+}
+
+static void simulate(frame_pipeline *p, render_list *list) {
+   int64_t start = pipeline_time_usec();
+   core_alloc_frame_begin(atomic_load_i32(&p->trap_allocs) != 0);
+   frame_arena_reset(&list->arena);
+   debug_draw_reset(&list->debug);
+   list->frame = p->next_frame++;
+   p->sim(p->user, list);
+   core_alloc_frame_end();
+   p->stats.sim_usec += pipeline_time_usec() - start;
+}
+
+static void sim_job(void *data, unsigned begin, unsigned end) {
+   frame_pipeline *p = (frame_pipeline *)data;
+   (void)begin;
+   (void)end;
+   simulate(p, p->in_flight);
+}
+
+bool pipeline_init(frame_pipeline *p, unsigned depth, pipeline_sim_t sim, void *user) {
+   unsigned i;
+   memset(p, 0, sizeof(*p));
+   p->sim = sim;
+   p->user = user;
+   job_counter_init(&p->counter);
+   pipeline_set_depth(p, NULL, depth);
+   for (i = 0; i < PIPELINE_MAX_DEPTH; i++)
+      if (!frame_arena_init(&p->lists[i].arena, PIPELINE_ARENA_SIZE) ||
+            !debug_draw_init(&p->lists[i].debug))
+         return false;
+   return true;
+}
+
+void pipeline_deinit(frame_pipeline *p, job_system_t *js) {
+   unsigned i;
+   pipeline_sync(p, js);
+   for (i = 0; i < PIPELINE_MAX_DEPTH; i++) {
+      frame_arena_deinit(&p->lists[i].arena);
+      debug_draw_deinit(&p->lists[i].debug);
+   }
+   memset(p, 0, sizeof(*p));
+}
+
+void pipeline_set_depth(frame_pipeline *p, job_system_t *js, unsigned depth) {
+   pipeline_sync(p, js);
+   if (depth < 1)
+      depth = 1;
+   if (depth > PIPELINE_MAX_DEPTH)
+      depth = PIPELINE_MAX_DEPTH;
+   p->depth = depth;
+   p->tail = 0;
+   p->ready = 0;
+   memset(&p->stats, 0, sizeof(p->stats));
+   p->stats.latency_frames = depth - 1;
+}
+
+void pipeline_sync(frame_pipeline *p, job_system_t *js) {
+   if (!p->in_flight)
+      return;
+   int64_t start = pipeline_time_usec();
+   job_wait(js, &p->counter);
+   p->stats.stall_usec += pipeline_time_usec() - start;
+   p->in_flight = NULL;
+   p->ready++;
+}
+
+const render_list *pipeline_next(frame_pipeline *p, job_system_t *js, const frame_input *input) {
+   render_list *list;
+   pipeline_sync(p, js);
+
+   // Fill the queue after a reset; these frames all see the current input
+   while (p->ready + 1 < p->depth) {
+      list = &p->lists[(p->tail + p->ready) % p->depth];
+      list->input = *input;
+      simulate(p, list);
+      p->ready++;
+   }
+
+   list = &p->lists[(p->tail + p->ready) % p->depth];
+   list->input = *input;
+   if (p->depth == 1 || !js) {
+      simulate(p, list);
+      p->ready++;
+   } else {
+      p->in_flight = list;
+      job_run(js, sim_job, p, &p->counter);
+   }
+
+   p->submit_start = pipeline_time_usec();
+   return &p->lists[p->tail];
+}
+
+void pipeline_retire(frame_pipeline *p) {
+   p->stats.submit_usec += pipeline_time_usec() - p->submit_start;
+   p->stats.frames++;
+   p->tail = (p->tail + 1) % p->depth;
+   p->ready--;
+}
+
+const render_list *pipeline_drain(frame_pipeline *p, job_system_t *js) {
+   const render_list *list;
+   pipeline_sync(p, js);
+   if (!p->ready)
+      return NULL;
+   list = &p->lists[p->tail];
+   p->tail = (p->tail + 1) % p->depth;
+   p->ready--;
+   return list;
+}
+
+void pipeline_get_stats(frame_pipeline *p, job_system_t *js, pipeline_stats *stats) {
+   unsigned i;
+   pipeline_sync(p, js);
+   *stats = p->stats;
+   stats->arena_high_water = 0;
+   for (i = 0; i < PIPELINE_MAX_DEPTH; i++)
+      if (p->lists[i].arena.high_water > stats->arena_high_water)
+         stats->arena_high_water = p->lists[i].arena.high_water;
+}
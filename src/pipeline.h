@@ -0,0 +1,125 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "jobs.h"
+#include "atomics.h"
+#include "arena.h"
+#include "commands.h"
+#include "tilemap.h"
+#include "particles.h"
+#include "text.h"
+#include "debug_draw.h"
+
+#define PIPELINE_MAX_DEPTH 3
+#define PIPELINE_ARENA_SIZE (64 * 1024) // Initial per-frame arena, grows to fit
+
+// Input sampled on the instance thread (frontend input callbacks are not
+// thread-safe) and handed to the simulation with the frame it belongs to
+typedef struct frame_input {
+   uint32_t buttons; // Bit n set when RETRO_DEVICE_ID_JOYPAD_n is pressed
+} frame_input;
+
+// Everything the render thread needs to submit one frame. Simulation
+// writes it, submission only reads it, so the two never share scene state.
+// Variable-size data comes from the list's arena, reset when the list
+// starts a new frame: with depth 1 that is every retro_run, deeper
+// pipelines keep one arena per frame in flight.
+typedef struct render_list {
+   frame_input input;
+   uint64_t frame; // Simulation frame index
+   float time;     // Simulation time, seconds
+   frame_arena arena;
+
+   float clear_color[4];
+   command_buffer commands; // Sorted and merged by the simulation
+
+   // Tile changes, applied to the tilemap before the frame is drawn
+   tile_edit *tile_edits;
+   unsigned tile_edit_count;
+
+   // Particle emitter for this frame; submission advances the GPU
+   // simulation with it before drawing
+   bool emit_particles;
+   particle_emitter emitter;
+
+   // Glyphs rasterized for this frame, uploaded before it is drawn
+   glyph_upload *glyph_uploads;
+   unsigned glyph_upload_count;
+
+   // Debug lines and shapes, flushed after the frame's commands. Fixed
+   // storage rather than arena memory, so recording works from any thread.
+   debug_draw debug;
+
+   // Entity snapshot (quad_batch streams)
+   unsigned entity_count;
+   float *x, *y, *w, *h;
+   uint32_t *color;
+} render_list;
+
+// Allocate count entity instances from the list's arena and set
+// entity_count; false on allocation failure
+bool render_list_alloc_entities(render_list *list, unsigned count);
+
+// Fills list from list->input, advancing the simulation by one frame
+typedef void (*pipeline_sim_t)(void *user, render_list *list);
+
+typedef struct pipeline_stats {
+   uint64_t frames;
+   unsigned latency_frames; // Extra frames between input and display
+   int64_t sim_usec;        // Total time simulating
+   int64_t submit_usec;     // Total time submitting on the instance thread
+   int64_t stall_usec;      // Total time the instance thread waited on simulation
+   size_t arena_high_water; // Largest frame arena footprint
+} pipeline_stats;
+
+// Ring of depth render lists. With depth 1, simulation and submission run
+// back to back. With depth n, the simulation of frame N+1 runs as a job
+// while frame N is submitted, and up to n - 1 simulated frames queue ahead
+// of the one being drawn: each adds one frame of input latency.
+typedef struct frame_pipeline {
+   render_list lists[PIPELINE_MAX_DEPTH];
+   unsigned depth;
+   unsigned tail;  // Oldest simulated list, next to submit
+   unsigned ready; // Simulated lists waiting to be submitted
+   uint64_t next_frame;
+
+   pipeline_sim_t sim;
+   void *user;
+   render_list *in_flight; // List the simulation job is writing
+   job_counter_t counter;
+   atomic_i32 trap_allocs; // Simulation runs in a trapping frame scope
+
+   int64_t submit_start;
+   pipeline_stats stats;
+} frame_pipeline;
+
+// Monotonic clock, microseconds
+int64_t pipeline_time_usec(void);
+
+bool pipeline_init(frame_pipeline *p, unsigned depth, pipeline_sim_t sim, void *user);
+// Waits for the simulation job and frees the render lists
+void pipeline_deinit(frame_pipeline *p, job_system_t *js);
+// Changing depth drops queued frames
+void pipeline_set_depth(frame_pipeline *p, job_system_t *js, unsigned depth);
+
+// Wait for the in-flight simulation. Call before touching simulation state
+// from the instance thread (options, teardown).
+void pipeline_sync(frame_pipeline *p, job_system_t *js);
+
+// Starts simulating the next frame with input and returns the oldest
+// simulated list to submit. Call pipeline_retire() once it is submitted.
+const render_list *pipeline_next(frame_pipeline *p, job_system_t *js, const frame_input *input);
+void pipeline_retire(frame_pipeline *p);
+
+// Waits for the in-flight simulation and pops the oldest simulated list
+// without submitting it; NULL once the queue is empty. The list stays
+// valid until the next pipeline_next(). Drain before tearing down state
+// that queued lists reference (options, teardown).
+const render_list *pipeline_drain(frame_pipeline *p, job_system_t *js);
+
+// Waits for the in-flight simulation
+void pipeline_get_stats(frame_pipeline *p, job_system_t *js, pipeline_stats *stats);
+
+#endif // PIPELINE_H
@@ -0,0 +1,299 @@
+#include "post.h"
+#include "core.h"
+#include <string.h>
+
+enum {
+   STEP_DOWNSAMPLE,
+   STEP_BLUR,
+   STEP_COMPOSITE
+};
+
+// One triangle covering the target; uv spans [0, 1] over it
+static const char *post_vertex_shader_src =
+   "#version 330 core\n"
+   "out vec2 uv;\n"
+   "void main() {\n"
+   "   vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+   "   uv = p;\n"
+   "   gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);\n"
+   "}\n";
+
+// Each bilinear tap sits on a texel corner and averages a 2x2 block, so
+// four of them box-filter the 4x4 source texels around the destination
+// texel. Pixels below the threshold luma are dropped, the rest scaled
+// down by it; a zero threshold keeps everything.
+static const char *downsample_fragment_shader_src =
+   "#version 330 core\n"
+   "in vec2 uv;\n"
+   "out vec4 frag_color;\n"
+   "uniform sampler2D source;\n"
+   "uniform vec2 texel;\n" // Source texel size
+   "uniform float threshold;\n"
+   "void main() {\n"
+   "   vec3 c = texture(source, uv + texel * vec2(-1.0, -1.0)).rgb;\n"
+   "   c += texture(source, uv + texel * vec2(1.0, -1.0)).rgb;\n"
+   "   c += texture(source, uv + texel * vec2(-1.0, 1.0)).rgb;\n"
+   "   c += texture(source, uv + texel * vec2(1.0, 1.0)).rgb;\n"
+   "   c *= 0.25;\n"
+   "   float luma = dot(c, vec3(0.2126, 0.7152, 0.0722));\n"
+   "   c *= max(luma - threshold, 0.0) / max(luma, 1e-4);\n"
+   "   frag_color = vec4(c, 1.0);\n"
+   "}\n";
+
+// 9-tap Gaussian (binomial, sigma ~1.6 texels) along one axis in five
+// fetches: each pair of outer taps is one bilinear fetch at the offset
+// that weights the two texels as the kernel does
+static const char *blur_fragment_shader_src =
+   "#version 330 core\n"
+   "in vec2 uv;\n"
+   "out vec4 frag_color;\n"
+   "uniform sampler2D source;\n"
+   "uniform vec2 step;\n" // One source texel along the blur axis
+   "void main() {\n"
+   "   vec3 c = texture(source, uv).rgb * 0.2270270270;\n"
+   "   c += (texture(source, uv + step * 1.3846153846).rgb + texture(source, uv - step * 1.3846153846).rgb) * 0.3162162162;\n"
+   "   c += (texture(source, uv + step * 3.2307692308).rgb + texture(source, uv - step * 3.2307692308).rgb) * 0.0702702703;\n"
+   "   frag_color = vec4(c, 1.0);\n"
+   "}\n";
+
+// Lower-resolution inputs are upsampled by the bilinear fetch. A disabled
+// effect's sampler has no texture, reads black and is weighted out.
+static const char *composite_fragment_shader_src =
+   "#version 330 core\n"
+   "in vec2 uv;\n"
+   "out vec4 frag_color;\n"
+   "uniform sampler2D scene;\n"
+   "uniform sampler2D bloom;\n"
+   "uniform sampler2D blurred;\n"
+   "uniform float bloom_intensity;\n"
+   "uniform float blur_mix;\n"
+   "void main() {\n"
+   "   vec3 c = mix(texture(scene, uv).rgb, texture(blurred, uv).rgb, blur_mix);\n"
+   "   c += texture(bloom, uv).rgb * bloom_intensity;\n"
+   "   frag_color = vec4(c, 1.0);\n"
+   "}\n";
+
+bool post_init(core_t *core, post_chain *post) {
+   memset(post, 0, sizeof(*post));
+   post->timing = -1;
+   post->downsample_program = core_create_shader_program(core, post_vertex_shader_src,
+         downsample_fragment_shader_src, "Post downsample");
+   post->blur_program = core_create_shader_program(core, post_vertex_shader_src,
+         blur_fragment_shader_src, "Post blur");
+   post->composite_program = core_create_shader_program(core, post_vertex_shader_src,
+         composite_fragment_shader_src, "Post composite");
+   if (!post->downsample_program || !post->blur_program || !post->composite_program) {
+      post_deinit(post);
+      return false;
+   }
+   post->down_source_loc = glGetUniformLocation(post->downsample_program, "source");
+   post->down_texel_loc = glGetUniformLocation(post->downsample_program, "texel");
+   post->down_threshold_loc = glGetUniformLocation(post->downsample_program, "threshold");
+   post->blur_source_loc = glGetUniformLocation(post->blur_program, "source");
+   post->blur_step_loc = glGetUniformLocation(post->blur_program, "step");
+   post->comp_scene_loc = glGetUniformLocation(post->composite_program, "scene");
+   post->comp_bloom_loc = glGetUniformLocation(post->composite_program, "bloom");
+   post->comp_blurred_loc = glGetUniformLocation(post->composite_program, "blurred");
+   post->comp_intensity_loc = glGetUniformLocation(post->composite_program, "bloom_intensity");
+   post->comp_mix_loc = glGetUniformLocation(post->composite_program, "blur_mix");
+
+   // Samplers never change units
+   glUseProgram(post->composite_program);
+   glUniform1i(post->comp_scene_loc, 0);
+   glUniform1i(post->comp_bloom_loc, 1);
+   glUniform1i(post->comp_blurred_loc, 2);
+   glUseProgram(post->downsample_program);
+   glUniform1i(post->down_source_loc, 0);
+   glUseProgram(post->blur_program);
+   glUniform1i(post->blur_source_loc, 0);
+   glUseProgram(0);
+
+   glGenVertexArrays(1, &post->vao);
+   // GLES has no GL_TIME_ELAPSED; the chain runs untimed there
+   post->timed = !core->gpu.gles;
+   if (post->timed)
+      glGenQueries(POST_TIMER_FRAMES * POST_STAGES, &post->queries[0][0]);
+   return true;
+}
+
+void post_deinit(post_chain *post) {
+   if (post->timing >= 0)
+      glEndQuery(GL_TIME_ELAPSED);
+   if (post->queries[0][0])
+      glDeleteQueries(POST_TIMER_FRAMES * POST_STAGES, &post->queries[0][0]);
+   if (post->vao)
+      glDeleteVertexArrays(1, &post->vao);
+   if (post->downsample_program)
+      glDeleteProgram(post->downsample_program);
+   if (post->blur_program)
+      glDeleteProgram(post->blur_program);
+   if (post->composite_program)
+      glDeleteProgram(post->composite_program);
+   memset(post, 0, sizeof(*post));
+   post->timing = -1;
+}
+
+// ---- GPU timers ----
+
+// Start a frame of measurements in the next slot, first collecting what
+// that slot measured POST_TIMER_FRAMES frames ago. A result still not
+// available by then is dropped rather than waited for.
+static void begin_timer_frame(post_chain *post) {
+   unsigned slot, s;
+   if (post->timing >= 0) { // A pass that would close it was skipped
+      glEndQuery(GL_TIME_ELAPSED);
+      post->timing = -1;
+   }
+   slot = ++post->timer_frame % POST_TIMER_FRAMES;
+   for (s = 0; s < POST_STAGES; s++) {
+      GLuint available = 0;
+      if (!post->query_pending[slot][s])
+         continue;
+      post->query_pending[slot][s] = false;
+      glGetQueryObjectuiv(post->queries[slot][s], GL_QUERY_RESULT_AVAILABLE, &available);
+      if (available) {
+         GLuint64 ns = 0;
+         glGetQueryObjectui64v(post->queries[slot][s], GL_QUERY_RESULT, &ns);
+         post->gpu_ns[s] += ns;
+         post->samples[s]++;
+      }
+   }
+}
+
+// Time-elapsed queries can't nest; stages are sequential anyway
+static void begin_timer(post_chain *post, int stage) {
+   if (!post->timed || post->timing >= 0)
+      return;
+   glBeginQuery(GL_TIME_ELAPSED, post->queries[post->timer_frame % POST_TIMER_FRAMES][stage]);
+   post->timing = stage;
+}
+
+static void end_timer(post_chain *post, int stage) {
+   if (post->timing != stage)
+      return;
+   glEndQuery(GL_TIME_ELAPSED);
+   post->query_pending[post->timer_frame % POST_TIMER_FRAMES][stage] = true;
+   post->timing = -1;
+}
+
+// ---- Passes ----
+
+static void run_step(void *user, const render_graph *graph) {
+   post_step *step = (post_step *)user;
+   post_chain *post = step->post;
+   if (step->begin_stage >= 0)
+      begin_timer(post, step->begin_stage);
+
+   glDisable(GL_BLEND);
+   glDisable(GL_DEPTH_TEST);
+   glBindVertexArray(post->vao);
+   switch (step->kind) {
+   case STEP_DOWNSAMPLE:
+      glUseProgram(post->downsample_program);
+      glUniform2f(post->down_texel_loc, step->step_x, step->step_y);
+      glUniform1f(post->down_threshold_loc, step->threshold);
+      glBindTexture(GL_TEXTURE_2D, render_graph_texture(graph, step->source));
+      break;
+   case STEP_BLUR:
+      glUseProgram(post->blur_program);
+      glUniform2f(post->blur_step_loc, step->step_x, step->step_y);
+      glBindTexture(GL_TEXTURE_2D, render_graph_texture(graph, step->source));
+      break;
+   default:
+      glUseProgram(post->composite_program);
+      glUniform1f(post->comp_intensity_loc, post->bloom_intensity);
+      glUniform1f(post->comp_mix_loc, post->blur_mix);
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, render_graph_texture(graph, step->bloom));
+      glActiveTexture(GL_TEXTURE2);
+      glBindTexture(GL_TEXTURE_2D, render_graph_texture(graph, step->blurred));
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, render_graph_texture(graph, step->source));
+      break;
+   }
+   glDrawArrays(GL_TRIANGLES, 0, 3);
+
+   if (step->kind == STEP_COMPOSITE) {
+      glActiveTexture(GL_TEXTURE1);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      glActiveTexture(GL_TEXTURE2);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      glActiveTexture(GL_TEXTURE0);
+   }
+   glBindTexture(GL_TEXTURE_2D, 0);
+   glBindVertexArray(0);
+   glUseProgram(0);
+
+   if (step->end_stage >= 0)
+      end_timer(post, step->end_stage);
+}
+
+static post_step *add_step(post_chain *post, render_graph *graph, const char *name, unsigned kind,
+      render_resource source, render_resource target, float step_x, float step_y) {
+   post_step *step;
+   if (post->step_count == POST_MAX_STEPS)
+      return NULL;
+   step = &post->steps[post->step_count++];
+   memset(step, 0, sizeof(*step));
+   step->post = post;
+   step->kind = kind;
+   step->source = source;
+   step->bloom = step->blurred = RENDER_RESOURCE_NONE;
+   step->step_x = step_x;
+   step->step_y = step_y;
+   step->begin_stage = step->end_stage = -1;
+   step->pass = render_graph_add_pass(graph, name, run_step, step);
+   render_graph_read(graph, step->pass, source);
+   render_graph_write(graph, step->pass, target, RENDER_RESOURCE_NONE);
+   return step;
+}
+
+void post_add_passes(post_chain *post, render_graph *graph, const post_settings *settings,
+      render_resource scene, render_resource output, unsigned width, unsigned height) {
+   unsigned hw = width / 2, hh = height / 2, qw = width / 4, qh = height / 4;
+   render_resource bloom = RENDER_RESOURCE_NONE, blurred = RENDER_RESOURCE_NONE;
+   post_step *step;
+
+   begin_timer_frame(post);
+   post->step_count = 0;
+   post->bloom_intensity = settings->bloom ? settings->bloom_intensity : 0.0f;
+   post->blur_mix = settings->blur ? settings->blur_mix : 0.0f;
+
+   // Bright pass into half resolution, then quarter, blurred there
+   if (settings->bloom) {
+      render_resource half = render_graph_create(graph, hw, hh, RENDER_FORMAT_RGBA8);
+      render_resource quarter = render_graph_create(graph, qw, qh, RENDER_FORMAT_RGBA8);
+      render_resource temp = render_graph_create(graph, qw, qh, RENDER_FORMAT_RGBA8);
+      bloom = render_graph_create(graph, qw, qh, RENDER_FORMAT_RGBA8);
+      if ((step = add_step(post, graph, "bloom bright pass", STEP_DOWNSAMPLE, scene, half,
+            1.0f / width, 1.0f / height))) {
+         step->threshold = settings->bloom_threshold;
+         step->begin_stage = POST_STAGE_BLOOM;
+      }
+      add_step(post, graph, "bloom downsample", STEP_DOWNSAMPLE, half, quarter, 1.0f / hw, 1.0f / hh);
+      add_step(post, graph, "bloom blur x", STEP_BLUR, quarter, temp, 1.0f / qw, 0.0f);
+      if ((step = add_step(post, graph, "bloom blur y", STEP_BLUR, temp, bloom, 0.0f, 1.0f / qh)))
+         step->end_stage = POST_STAGE_BLOOM;
+   }
+
+   // Whole scene into half resolution, blurred there
+   if (settings->blur) {
+      render_resource half = render_graph_create(graph, hw, hh, RENDER_FORMAT_RGBA8);
+      render_resource temp = render_graph_create(graph, hw, hh, RENDER_FORMAT_RGBA8);
+      blurred = render_graph_create(graph, hw, hh, RENDER_FORMAT_RGBA8);
+      if ((step = add_step(post, graph, "blur downsample", STEP_DOWNSAMPLE, scene, half,
+            1.0f / width, 1.0f / height)))
+         step->begin_stage = POST_STAGE_BLUR;
+      add_step(post, graph, "blur x", STEP_BLUR, half, temp, 1.0f / hw, 0.0f);
+      if ((step = add_step(post, graph, "blur y", STEP_BLUR, temp, blurred, 0.0f, 1.0f / hh)))
+         step->end_stage = POST_STAGE_BLUR;
+   }
+
+   if ((step = add_step(post, graph, "post composite", STEP_COMPOSITE, scene, output, 0.0f, 0.0f))) {
+      step->bloom = bloom;
+      step->blurred = blurred;
+      step->begin_stage = step->end_stage = POST_STAGE_COMPOSITE;
+      render_graph_read(graph, step->pass, bloom);
+      render_graph_read(graph, step->pass, blurred);
+   }
+}
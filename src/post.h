@@ -0,0 +1,91 @@
+#ifndef POST_H
+#define POST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+#include <retro_inline.h>
+#include "render_graph.h"
+
+#define POST_MAX_STEPS 12   // Passes one frame's chain declares
+#define POST_TIMER_FRAMES 4 // Frames of GPU timer queries in flight
+
+// Stages whose GPU time is measured
+enum post_stage {
+   POST_STAGE_BLOOM,     // Bright pass, downsamples and blur
+   POST_STAGE_BLUR,      // Downsample and blur of the whole scene
+   POST_STAGE_COMPOSITE, // Full-resolution combine into the output
+   POST_STAGES
+};
+
+typedef struct post_settings {
+   bool bloom, blur;
+   float bloom_threshold; // Luma a pixel needs before it glows
+   float bloom_intensity;
+   float blur_mix;        // 0 = sharp scene, 1 = fully blurred
+} post_settings;
+
+// Per-pass parameters, alive until the graph executes
+typedef struct post_step {
+   struct post_chain *post;
+   unsigned kind;
+   render_resource source;
+   render_resource bloom, blurred; // Composite inputs
+   float step_x, step_y;           // Source texels per unit of the pass's offsets
+   float threshold;
+   int begin_stage, end_stage;     // Timer query to open before / close after, -1 = none
+   int pass;                       // In the graph, -1 if it was full
+} post_step;
+
+// Bloom and Gaussian blur on a downsampled chain, run as render graph
+// passes between the scene and the output. The scene is downsampled to
+// half resolution with four bilinear taps (a 4x4 box for the cost of
+// four fetches), bloom's bright pass folded into that first step, and
+// bloom downsamples once more to quarter resolution. Blurs are separable
+// 9-tap Gaussians in five fetches each way, adjacent taps merged into one
+// bilinear fetch at their weighted offset: bloom blurs at quarter
+// resolution, the full-scene blur at half. Only the composite runs at
+// full resolution, so the chain's cost follows a fraction of the output
+// size.
+//
+// Each stage's GPU time is measured with GL_TIME_ELAPSED queries, read
+// back POST_TIMER_FRAMES frames later so the CPU never waits for them
+// (desktop GL only).
+// Instance thread only.
+typedef struct post_chain {
+   GLuint vao; // Empty; the fullscreen triangle comes from gl_VertexID
+   GLuint downsample_program, blur_program, composite_program;
+   GLint down_source_loc, down_texel_loc, down_threshold_loc;
+   GLint blur_source_loc, blur_step_loc;
+   GLint comp_scene_loc, comp_bloom_loc, comp_blurred_loc, comp_intensity_loc, comp_mix_loc;
+   float bloom_intensity, blur_mix; // Of the frame being declared
+
+   post_step steps[POST_MAX_STEPS];
+   unsigned step_count;
+
+   bool timed; // Timer queries are available
+   GLuint queries[POST_TIMER_FRAMES][POST_STAGES];
+   bool query_pending[POST_TIMER_FRAMES][POST_STAGES];
+   unsigned timer_frame;
+   int timing; // Stage with an open query, -1 = none
+
+   uint64_t gpu_ns[POST_STAGES];  // Measured GPU time since init
+   uint64_t samples[POST_STAGES]; // Frames measured
+} post_chain;
+
+struct core;
+
+// Needs a current GL context
+bool post_init(struct core *core, post_chain *post);
+void post_deinit(post_chain *post);
+
+static INLINE bool post_enabled(const post_settings *settings) {
+   return settings->bloom || settings->blur;
+}
+
+// Declare passes that read scene (width x height) and write the processed
+// image to output; settings must enable at least one effect
+void post_add_passes(post_chain *post, render_graph *graph, const post_settings *settings,
+      render_resource scene, render_resource output, unsigned width, unsigned height);
+
+#endif // POST_H
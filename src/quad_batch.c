@@ -0,0 +1,201 @@
+#include "quad_batch.h"
+#include "core.h"
+#include <string.h>
+
+// Corners come from gl_VertexID (triangle strip), everything else is
+// per-instance
+static const char *quad_vertex_shader_src =
+   "#version 330 core\n"
+   "layout(location = 0) in vec2 inst_pos;\n"
+   "layout(location = 1) in vec2 inst_size;\n"
+   "layout(location = 2) in vec4 inst_color;\n"
+   "layout(location = 3) in float inst_depth;\n"
+   "uniform vec2 viewport;\n"
+   "out vec4 v_color;\n"
+   "void main() {\n"
+   "   vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));\n"
+   "   vec2 pixel = inst_pos * (1.0 / 16.0) + (corner - 0.5) * inst_size;\n"
+   "   gl_Position = vec4(pixel.x / viewport.x * 2.0 - 1.0, 1.0 - pixel.y / viewport.y * 2.0, inst_depth * 2.0 - 1.0, 1.0);\n"
+   "   v_color = inst_color;\n"
+   "}\n";
+
+static const char *quad_fragment_shader_src =
+   "#version 330 core\n"
+   "in vec4 v_color;\n"
+   "out vec4 frag_color;\n"
+   "void main() {\n"
+   "   frag_color = v_color;\n"
+   "}\n";
+
+// Same quads, textured from a distance field atlas: each instance maps its
+// corners onto one uv_size square starting at inst_uv
+static const char *sdf_vertex_shader_src =
+   "#version 330 core\n"
+   "layout(location = 0) in vec2 inst_pos;\n"
+   "layout(location = 1) in vec2 inst_size;\n"
+   "layout(location = 2) in vec4 inst_color;\n"
+   "layout(location = 3) in float inst_depth;\n"
+   "layout(location = 4) in vec2 inst_uv;\n"
+   "uniform vec2 viewport;\n"
+   "uniform float uv_size;\n"
+   "out vec4 v_color;\n"
+   "out vec2 v_uv;\n"
+   "void main() {\n"
+   "   vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));\n"
+   "   vec2 pixel = inst_pos * (1.0 / 16.0) + (corner - 0.5) * inst_size;\n"
+   "   gl_Position = vec4(pixel.x / viewport.x * 2.0 - 1.0, 1.0 - pixel.y / viewport.y * 2.0, inst_depth * 2.0 - 1.0, 1.0);\n"
+   "   v_color = inst_color;\n"
+   "   v_uv = inst_uv + corner * uv_size;\n"
+   "}\n";
+
+// Coverage from the distance to the 0.5 outline, antialiased over about
+// one screen pixel at any scale
+static const char *sdf_fragment_shader_src =
+   "#version 330 core\n"
+   "in vec4 v_color;\n"
+   "in vec2 v_uv;\n"
+   "uniform sampler2D atlas;\n"
+   "out vec4 frag_color;\n"
+   "void main() {\n"
+   "   float d = texture(atlas, v_uv).r;\n"
+   "   float w = max(fwidth(d) * 0.5, 1.0 / 255.0);\n"
+   "   frag_color = vec4(v_color.rgb, v_color.a * smoothstep(0.5 - w, 0.5 + w, d));\n"
+   "}\n";
+
+// Per-instance layout, one structure-of-arrays stream per attribute, 4
+// bytes per instance each: 12.4 fixed-point center, half-float size,
+// RGBA8 color, then depth and atlas uv when the batch has them. 12 to 20
+// bytes an instance where the caller's float streams take 20 to 28.
+enum { ATTR_POS, ATTR_SIZE, ATTR_COLOR, ATTR_DEPTH, ATTR_UV, ATTR_COUNT };
+
+static const gpu_attrib instance_attribs[ATTR_COUNT] = {
+   { ATTR_POS, 2, GPU_ATTRIB_PIXEL, 0 },
+   { ATTR_SIZE, 2, GPU_ATTRIB_HALF, 0 },
+   { ATTR_COLOR, 4, GPU_ATTRIB_UNORM8, 0 },
+   { ATTR_DEPTH, 1, GPU_ATTRIB_FLOAT, 0 },
+   { ATTR_UV, 2, GPU_ATTRIB_UNORM16, 0 },
+};
+
+// Each submit points the attributes at the range it reserved in the
+// instance stream
+static void setup_attributes(quad_batch *batch) {
+   unsigned i;
+
+   glBindVertexArray(batch->vao);
+   for (i = 0; i < ATTR_COUNT; i++) {
+      if (i < ATTR_DEPTH)
+         glEnableVertexAttribArray(i);
+      glVertexAttribDivisor(i, 1);
+   }
+   glBindVertexArray(0);
+}
+
+bool quad_batch_init(core_t *core, quad_batch *batch, unsigned capacity) {
+   memset(batch, 0, sizeof(*batch));
+   batch->program = core_create_shader_program(core, quad_vertex_shader_src, quad_fragment_shader_src, "Quad batch");
+   if (!batch->program)
+      return false;
+   batch->viewport_loc = glGetUniformLocation(batch->program, "viewport");
+   batch->sdf_program = core_create_shader_program(core, sdf_vertex_shader_src, sdf_fragment_shader_src, "Quad batch SDF");
+   if (!batch->sdf_program) {
+      quad_batch_deinit(batch);
+      return false;
+   }
+   batch->sdf_viewport_loc = glGetUniformLocation(batch->sdf_program, "viewport");
+   batch->sdf_uv_size_loc = glGetUniformLocation(batch->sdf_program, "uv_size");
+   glUseProgram(batch->sdf_program);
+   glUniform1i(glGetUniformLocation(batch->sdf_program, "atlas"), 0);
+   glUseProgram(0);
+
+   glGenVertexArrays(1, &batch->vao);
+   // Room for every stream of capacity instances per segment
+   if (!gpu_stream_init(&batch->instances, &core->gpu, (GLsizeiptr)(capacity ? capacity : 1) * 4 * ATTR_COUNT)) {
+      quad_batch_deinit(batch);
+      return false;
+   }
+   setup_attributes(batch);
+   core_check_gl_error(core, "quad_batch_init");
+   return true;
+}
+
+void quad_batch_deinit(quad_batch *batch) {
+   if (batch->program)
+      glDeleteProgram(batch->program);
+   if (batch->sdf_program)
+      glDeleteProgram(batch->sdf_program);
+   if (batch->instances.buffer)
+      gpu_stream_deinit(&batch->instances);
+   if (batch->vao)
+      glDeleteVertexArrays(1, &batch->vao);
+   memset(batch, 0, sizeof(*batch));
+}
+
+void quad_batch_bind(quad_batch *batch, float vp_width, float vp_height) {
+   glUseProgram(batch->program);
+   glUniform2f(batch->viewport_loc, vp_width, vp_height);
+   glBindVertexArray(batch->vao);
+}
+
+void quad_batch_bind_sdf(quad_batch *batch, float vp_width, float vp_height, float uv_size) {
+   glUseProgram(batch->sdf_program);
+   glUniform2f(batch->sdf_viewport_loc, vp_width, vp_height);
+   glUniform1f(batch->sdf_uv_size_loc, uv_size);
+   glBindVertexArray(batch->vao);
+}
+
+// Streams are packed back to back into one reservation: position, size
+// and color, then depth and uv when the batch has them
+void quad_batch_submit(quad_batch *batch, const quad_streams *streams) {
+   GLsizeiptr bytes = (GLsizeiptr)streams->count * 4;
+   unsigned count = ATTR_DEPTH + (streams->depth != NULL) + (streams->uv != NULL);
+   GLintptr offset, next;
+   uint8_t *dst;
+   int16_t *pos;
+   uint16_t *size;
+   unsigned i;
+
+   if (streams->count == 0)
+      return;
+   dst = (uint8_t *)gpu_stream_map(&batch->instances, bytes * count, &offset);
+   if (!dst)
+      return;
+   pos = (int16_t *)dst;
+   size = (uint16_t *)(dst + bytes);
+   for (i = 0; i < streams->count; i++) {
+      pos[i * 2] = gpu_pack_pixel(streams->x[i]);
+      pos[i * 2 + 1] = gpu_pack_pixel(streams->y[i]);
+      size[i * 2] = gpu_pack_half(streams->w[i]);
+      size[i * 2 + 1] = gpu_pack_half(streams->h[i]);
+   }
+   memcpy(dst + bytes * 2, streams->color, (size_t)bytes);
+   next = bytes * 3;
+   if (streams->depth) {
+      memcpy(dst + next, streams->depth, (size_t)bytes);
+      next += bytes;
+   }
+   if (streams->uv)
+      memcpy(dst + next, streams->uv, (size_t)bytes);
+   gpu_stream_unmap(&batch->instances);
+
+   // The stream is still bound to GL_ARRAY_BUFFER
+   for (i = 0; i < ATTR_DEPTH; i++)
+      gpu_attrib_pointer(&instance_attribs[i], 4, offset + bytes * i);
+   next = offset + bytes * 3;
+   if (streams->depth) {
+      gpu_attrib_pointer(&instance_attribs[ATTR_DEPTH], 4, next);
+      glEnableVertexAttribArray(ATTR_DEPTH);
+      next += bytes;
+   } else {
+      // Disabled arrays read the current generic attribute value
+      glDisableVertexAttribArray(ATTR_DEPTH);
+      glVertexAttrib1f(ATTR_DEPTH, streams->const_depth);
+   }
+   if (streams->uv) {
+      gpu_attrib_pointer(&instance_attribs[ATTR_UV], 4, next);
+      glEnableVertexAttribArray(ATTR_UV);
+   } else {
+      glDisableVertexAttribArray(ATTR_UV);
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)streams->count);
+}
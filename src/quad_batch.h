@@ -0,0 +1,41 @@
+#ifndef QUAD_BATCH_H
+#define QUAD_BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+#include "commands.h"
+#include "gpu.h"
+
+// Instanced quad renderer. Instance data is consumed straight from
+// structure-of-arrays streams (center x/y, size w/h, packed RGBA8 color,
+// depth, atlas uv), each packed into its own range of one stream
+// reservation, so callers never interleave. Coordinates are in pixels with
+// a top-left origin, matching draw_solid_quad; centers are packed to 12.4
+// fixed point (so must lie within 2048 pixels of the corner) and sizes to
+// half floats. The SDF program shades the same instances as glyphs from a
+// distance field atlas bound to texture unit 0.
+typedef struct quad_batch {
+   GLuint program;
+   GLint viewport_loc;
+   GLuint sdf_program;
+   GLint sdf_viewport_loc, sdf_uv_size_loc;
+   GLuint vao;
+   gpu_stream instances;
+} quad_batch;
+
+struct core;
+
+// capacity sizes the stream segments; larger submits grow them
+bool quad_batch_init(struct core *core, quad_batch *batch, unsigned capacity);
+void quad_batch_deinit(quad_batch *batch);
+
+// Bind the batch program and VAO for a viewport; submits until the next
+// program change reuse them
+void quad_batch_bind(quad_batch *batch, float vp_width, float vp_height);
+// Same for the SDF program; uv_size is one glyph's extent in the atlas
+void quad_batch_bind_sdf(quad_batch *batch, float vp_width, float vp_height, float uv_size);
+// Upload and draw the streams; the batch must be bound
+void quad_batch_submit(quad_batch *batch, const quad_streams *streams);
+
+#endif // QUAD_BATCH_H
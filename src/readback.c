@@ -0,0 +1,90 @@
+#include "readback.h"
+#include <string.h>
+
+bool readback_init(readback_ring *ring, unsigned width, unsigned height) {
+   unsigned i;
+   memset(ring, 0, sizeof(*ring));
+   ring->width = width;
+   ring->height = height;
+   for (i = 0; i < READBACK_SLOTS; i++) {
+      glGenBuffers(1, &ring->slots[i].pbo);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, ring->slots[i].pbo);
+      glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+   }
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   ring->initialized = glGetError() == GL_NO_ERROR;
+   if (!ring->initialized)
+      readback_deinit(ring);
+   return ring->initialized;
+}
+
+void readback_deinit(readback_ring *ring) {
+   unsigned i;
+   for (i = 0; i < READBACK_SLOTS; i++) {
+      if (ring->slots[i].fence)
+         glDeleteSync(ring->slots[i].fence);
+      if (ring->slots[i].pbo)
+         glDeleteBuffers(1, &ring->slots[i].pbo);
+   }
+   memset(ring, 0, sizeof(*ring));
+}
+
+// Map the oldest slot and hand it to the sink
+static void deliver_oldest(readback_ring *ring, core_frame_sink_t sink, void *user) {
+   readback_slot *slot = &ring->slots[ring->head];
+   size_t size = (size_t)ring->width * ring->height * 4;
+
+   glDeleteSync(slot->fence);
+   slot->fence = NULL;
+   if (sink) {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+      const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+      if (pixels) {
+         sink(user, pixels, ring->width, ring->height, (size_t)ring->width * 4, slot->frame_index);
+         glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   }
+   slot->pending = false;
+   ring->head = (ring->head + 1) % READBACK_SLOTS;
+   ring->count--;
+}
+
+void readback_queue(readback_ring *ring, GLuint fbo, uint64_t frame_index,
+      core_frame_sink_t sink, void *user) {
+   if (!ring->initialized)
+      return;
+   if (ring->count == READBACK_SLOTS) {
+      readback_slot *oldest = &ring->slots[ring->head];
+      glClientWaitSync(oldest->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+      deliver_oldest(ring, sink, user);
+   }
+
+   readback_slot *slot = &ring->slots[(ring->head + ring->count) % READBACK_SLOTS];
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+   glReadBuffer(fbo ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+   glPixelStorei(GL_PACK_ALIGNMENT, 4);
+   glReadPixels(0, 0, (GLsizei)ring->width, (GLsizei)ring->height, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+   glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+   slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+   slot->frame_index = frame_index;
+   slot->pending = true;
+   ring->count++;
+}
+
+unsigned readback_poll(readback_ring *ring, bool wait, core_frame_sink_t sink, void *user) {
+   unsigned delivered = 0;
+   while (ring->initialized && ring->count > 0) {
+      readback_slot *oldest = &ring->slots[ring->head];
+      GLenum result = glClientWaitSync(oldest->fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+            wait ? GL_TIMEOUT_IGNORED : 0);
+      if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+         break;
+      deliver_oldest(ring, sink, user);
+      delivered++;
+   }
+   return delivered;
+}
@@ -0,0 +1,47 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+
+// Number of frames that can be in flight between glReadPixels and the CPU
+#define READBACK_SLOTS 4
+
+// Receives a finished frame: RGBA8, rows bottom-to-top (GL order).
+// The pixel pointer is only valid for the duration of the call.
+typedef void (*core_frame_sink_t)(void *user, const void *pixels, unsigned width,
+      unsigned height, size_t pitch, uint64_t frame_index);
+
+typedef struct readback_slot {
+   GLuint pbo;
+   GLsync fence;
+   uint64_t frame_index;
+   bool pending;
+} readback_slot;
+
+// Async readback ring: each queued frame is copied into a pixel buffer
+// object and fenced; the CPU only maps it once the GPU has finished, so
+// rendering the next frames overlaps with the transfer.
+typedef struct readback_ring {
+   readback_slot slots[READBACK_SLOTS];
+   unsigned head;  // Oldest pending slot
+   unsigned count; // Pending slots
+   unsigned width, height;
+   bool initialized;
+} readback_ring;
+
+bool readback_init(readback_ring *ring, unsigned width, unsigned height);
+void readback_deinit(readback_ring *ring);
+
+// Start reading back the color attachment of fbo. If every slot is busy the
+// oldest frame is completed (blocking) and delivered first.
+void readback_queue(readback_ring *ring, GLuint fbo, uint64_t frame_index,
+      core_frame_sink_t sink, void *user);
+
+// Deliver completed frames in order. With wait set, blocks until every
+// pending frame has been delivered. Returns the number delivered.
+unsigned readback_poll(readback_ring *ring, bool wait, core_frame_sink_t sink, void *user);
+
+#endif // READBACK_H
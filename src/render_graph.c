@@ -0,0 +1,384 @@
+#include "render_graph.h"
+#include <string.h>
+
+// ---- Pool ----
+
+void render_target_pool_init(render_target_pool *pool, const gpu_caps *caps) {
+   memset(pool, 0, sizeof(*pool));
+   pool->caps = caps;
+}
+
+static void delete_fbo(render_fbo *f) {
+   glDeleteFramebuffers(1, &f->fbo);
+   memset(f, 0, sizeof(*f));
+}
+
+static void delete_target(render_target_pool *pool, render_target *t) {
+   unsigned i;
+   for (i = 0; i < RENDER_FBO_CACHE_SIZE; i++) {
+      render_fbo *f = &pool->fbos[i];
+      if (f->fbo && (f->color == t->texture || f->depth == t->texture))
+         delete_fbo(f);
+   }
+   glDeleteTextures(1, &t->texture);
+   memset(t, 0, sizeof(*t));
+   pool->freed++;
+}
+
+void render_target_pool_deinit(render_target_pool *pool) {
+   unsigned i;
+   for (i = 0; i < RENDER_TARGET_POOL_SIZE; i++)
+      if (pool->targets[i].texture)
+         delete_target(pool, &pool->targets[i]);
+   for (i = 0; i < RENDER_FBO_CACHE_SIZE; i++)
+      if (pool->fbos[i].fbo)
+         delete_fbo(&pool->fbos[i]);
+   memset(pool, 0, sizeof(*pool));
+}
+
+static GLenum internal_format(unsigned format) {
+   switch (format) {
+   case RENDER_FORMAT_DEPTH24:
+      return GL_DEPTH_COMPONENT24;
+   case RENDER_FORMAT_RGBA16F:
+      return GL_RGBA16F;
+   default:
+      return GL_RGBA8;
+   }
+}
+
+static GLuint create_texture(const gpu_caps *caps, unsigned width, unsigned height, unsigned format) {
+   GLuint tex;
+   // Post passes sample between texels and at the edges
+   if (caps->direct_state_access) {
+      // Immutable storage, set up without touching the texture bindings
+      glCreateTextures(GL_TEXTURE_2D, 1, &tex);
+      glTextureStorage2D(tex, 1, internal_format(format), width, height);
+      glTextureParameteri(tex, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTextureParameteri(tex, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTextureParameteri(tex, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTextureParameteri(tex, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      return tex;
+   }
+   glGenTextures(1, &tex);
+   glBindTexture(GL_TEXTURE_2D, tex);
+   switch (format) {
+   case RENDER_FORMAT_DEPTH24:
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+      break;
+   case RENDER_FORMAT_RGBA16F:
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+      break;
+   default:
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+      break;
+   }
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   glBindTexture(GL_TEXTURE_2D, 0);
+   return tex;
+}
+
+// A free texture matching the resource, created if the pool has room (or
+// has a texture this frame doesn't use to make room with); -1 if neither
+static int acquire_target(render_target_pool *pool, const render_graph_resource *r) {
+   int empty = -1, idle = -1;
+   unsigned i;
+   for (i = 0; i < RENDER_TARGET_POOL_SIZE; i++) {
+      render_target *t = &pool->targets[i];
+      if (!t->texture) {
+         if (empty < 0)
+            empty = (int)i;
+      } else if (!t->in_use) {
+         if (t->width == r->width && t->height == r->height && t->format == r->format) {
+            empty = (int)i;
+            break;
+         }
+         if (t->last_used != pool->frame && (idle < 0 || t->last_used < pool->targets[idle].last_used))
+            idle = (int)i;
+      }
+   }
+   if (empty < 0 && idle >= 0) {
+      delete_target(pool, &pool->targets[idle]);
+      empty = idle;
+   }
+   if (empty < 0)
+      return -1;
+
+   render_target *t = &pool->targets[empty];
+   if (!t->texture) {
+      t->width = r->width;
+      t->height = r->height;
+      t->format = r->format;
+      t->texture = create_texture(pool->caps, r->width, r->height, r->format);
+      pool->created++;
+   }
+   t->in_use = true;
+   t->last_used = pool->frame;
+   return empty;
+}
+
+// Framebuffer over the given attachments, built the first time they are
+// written together
+static GLuint acquire_fbo(render_target_pool *pool, GLuint color, GLuint depth) {
+   static const GLenum no_color = GL_NONE;
+   render_fbo *slot = NULL;
+   unsigned i;
+   for (i = 0; i < RENDER_FBO_CACHE_SIZE; i++) {
+      render_fbo *f = &pool->fbos[i];
+      if (f->fbo && f->color == color && f->depth == depth) {
+         f->last_used = pool->frame;
+         return f->fbo;
+      }
+      if (!slot || !f->fbo || (slot->fbo && f->last_used < slot->last_used))
+         slot = f;
+   }
+   if (slot->fbo)
+      delete_fbo(slot);
+   glGenFramebuffers(1, &slot->fbo);
+   glBindFramebuffer(GL_FRAMEBUFFER, slot->fbo);
+   if (color)
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+   else
+      glDrawBuffers(1, &no_color); // glDrawBuffer is desktop-only
+   if (depth)
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+   slot->color = color;
+   slot->depth = depth;
+   slot->last_used = pool->frame;
+   return slot->fbo;
+}
+
+// ---- Graph ----
+
+void render_graph_begin(render_graph *graph, render_target_pool *pool) {
+   graph->pool = pool;
+   graph->resource_count = 0;
+   graph->pass_count = 0;
+   graph->overflowed = false;
+}
+
+static render_resource add_resource(render_graph *graph, unsigned width, unsigned height, unsigned format) {
+   render_graph_resource *r;
+   if (graph->resource_count == RENDER_GRAPH_MAX_RESOURCES) {
+      graph->overflowed = true;
+      return RENDER_RESOURCE_NONE;
+   }
+   r = &graph->resources[graph->resource_count];
+   memset(r, 0, sizeof(*r));
+   r->width = width;
+   r->height = height;
+   r->format = format;
+   r->first = r->last = r->target = -1;
+   return (render_resource)graph->resource_count++;
+}
+
+render_resource render_graph_import(render_graph *graph, GLuint fbo, unsigned width, unsigned height) {
+   render_resource res = add_resource(graph, width, height, RENDER_FORMAT_RGBA8);
+   if (res != RENDER_RESOURCE_NONE) {
+      graph->resources[res].imported = true;
+      graph->resources[res].fbo = fbo;
+   }
+   return res;
+}
+
+render_resource render_graph_create(render_graph *graph, unsigned width, unsigned height, unsigned format) {
+   return add_resource(graph, width, height, format);
+}
+
+int render_graph_add_pass(render_graph *graph, const char *name, render_pass_fn fn, void *user) {
+   render_graph_pass *p;
+   if (graph->pass_count == RENDER_GRAPH_MAX_PASSES) {
+      graph->overflowed = true;
+      return -1;
+   }
+   p = &graph->passes[graph->pass_count];
+   memset(p, 0, sizeof(*p));
+   p->name = name;
+   p->fn = fn;
+   p->user = user;
+   p->color = p->depth = RENDER_RESOURCE_NONE;
+   return (int)graph->pass_count++;
+}
+
+void render_graph_read(render_graph *graph, int pass, render_resource resource) {
+   render_graph_pass *p;
+   if (pass < 0 || resource == RENDER_RESOURCE_NONE)
+      return;
+   p = &graph->passes[pass];
+   if (p->read_count == RENDER_GRAPH_MAX_READS) {
+      graph->overflowed = true;
+      return;
+   }
+   p->reads[p->read_count++] = resource;
+}
+
+void render_graph_write(render_graph *graph, int pass, render_resource color, render_resource depth) {
+   if (pass < 0)
+      return;
+   graph->passes[pass].color = color;
+   graph->passes[pass].depth = depth;
+}
+
+GLuint render_graph_texture(const render_graph *graph, render_resource resource) {
+   const render_graph_resource *r;
+   if (resource == RENDER_RESOURCE_NONE)
+      return 0;
+   r = &graph->resources[resource];
+   return r->target >= 0 ? graph->pool->targets[r->target].texture : 0;
+}
+
+static void touch(render_graph *graph, render_resource res, int pass) {
+   render_graph_resource *r;
+   if (res == RENDER_RESOURCE_NONE)
+      return;
+   r = &graph->resources[res];
+   if (r->first < 0)
+      r->first = pass;
+   r->last = pass;
+}
+
+// Walking back from the imported targets, a pass lives if a live pass
+// after it (or the frontend) consumes what it writes
+static void cull(render_graph *graph) {
+   bool needed[RENDER_GRAPH_MAX_RESOURCES];
+   unsigned i;
+   int p;
+   for (i = 0; i < graph->resource_count; i++)
+      needed[i] = graph->resources[i].imported;
+   graph->culled = 0;
+   for (p = (int)graph->pass_count - 1; p >= 0; p--) {
+      render_graph_pass *pass = &graph->passes[p];
+      pass->live = (pass->color != RENDER_RESOURCE_NONE && needed[pass->color]) ||
+            (pass->depth != RENDER_RESOURCE_NONE && needed[pass->depth]);
+      if (!pass->live) {
+         graph->culled++;
+         continue;
+      }
+      for (i = 0; i < pass->read_count; i++)
+         needed[pass->reads[i]] = true;
+   }
+   for (p = 0; p < (int)graph->pass_count; p++) {
+      render_graph_pass *pass = &graph->passes[p];
+      if (!pass->live)
+         continue;
+      for (i = 0; i < pass->read_count; i++)
+         touch(graph, pass->reads[i], p);
+      touch(graph, pass->color, p);
+      touch(graph, pass->depth, p);
+   }
+}
+
+// Discard the pass's transient attachments whose first (on_first) or last
+// use this pass is
+static void invalidate(render_graph *graph, const render_graph_pass *pass, int index, bool on_first) {
+   GLenum attachments[2];
+   GLsizei count = 0;
+   if (!graph->pool->caps->invalidate_subdata)
+      return;
+   if (pass->color != RENDER_RESOURCE_NONE) {
+      const render_graph_resource *r = &graph->resources[pass->color];
+      if (!r->imported && (on_first ? r->first : r->last) == index)
+         attachments[count++] = GL_COLOR_ATTACHMENT0;
+   }
+   if (pass->depth != RENDER_RESOURCE_NONE) {
+      const render_graph_resource *r = &graph->resources[pass->depth];
+      if (!r->imported && (on_first ? r->first : r->last) == index)
+         attachments[count++] = GL_DEPTH_ATTACHMENT;
+   }
+   if (count)
+      glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments);
+}
+
+// Give resources first used by this pass a texture; false if the pool ran
+// out
+static bool acquire_resources(render_graph *graph, const render_graph_pass *pass, int index) {
+   render_resource used[RENDER_GRAPH_MAX_READS + 2];
+   unsigned n = 0, i;
+   for (i = 0; i < pass->read_count; i++)
+      used[n++] = pass->reads[i];
+   used[n++] = pass->color;
+   used[n++] = pass->depth;
+   for (i = 0; i < n; i++) {
+      render_graph_resource *r;
+      if (used[i] == RENDER_RESOURCE_NONE)
+         continue;
+      r = &graph->resources[used[i]];
+      if (r->imported || r->target >= 0)
+         continue;
+      if (r->first != index)
+         return false; // Its first user was starved
+      if ((r->target = acquire_target(graph->pool, r)) < 0)
+         return false;
+   }
+   return true;
+}
+
+// Hand back the textures of resources this pass used last, so later
+// resources alias them
+static void release_resources(render_graph *graph, int index) {
+   unsigned i;
+   for (i = 0; i < graph->resource_count; i++) {
+      render_graph_resource *r = &graph->resources[i];
+      if (r->last == index && r->target >= 0) {
+         graph->pool->targets[r->target].in_use = false;
+         r->target = -1;
+      }
+   }
+}
+
+void render_graph_execute(render_graph *graph) {
+   render_target_pool *pool = graph->pool;
+   unsigned i;
+   int p;
+
+   cull(graph);
+   graph->executed = graph->starved = 0;
+   for (p = 0; p < (int)graph->pass_count; p++) {
+      const render_graph_pass *pass = &graph->passes[p];
+      const render_graph_resource *color, *depth;
+      GLuint fbo;
+      if (!pass->live)
+         continue;
+      if (!acquire_resources(graph, pass, p)) {
+         graph->starved++;
+         release_resources(graph, p);
+         continue;
+      }
+
+      color = pass->color != RENDER_RESOURCE_NONE ? &graph->resources[pass->color] : NULL;
+      depth = pass->depth != RENDER_RESOURCE_NONE ? &graph->resources[pass->depth] : NULL;
+      if (color && color->imported)
+         fbo = color->fbo;
+      else
+         fbo = acquire_fbo(pool, render_graph_texture(graph, pass->color),
+               render_graph_texture(graph, pass->depth));
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      if (color)
+         glViewport(0, 0, color->width, color->height);
+      else
+         glViewport(0, 0, depth->width, depth->height);
+      invalidate(graph, pass, p, true);
+
+      pass->fn(pass->user, graph);
+      graph->executed++;
+
+      invalidate(graph, pass, p, false);
+      release_resources(graph, p);
+   }
+
+   // Free what the last RENDER_TARGET_IDLE_FRAMES frames didn't use
+   for (i = 0; i < RENDER_TARGET_POOL_SIZE; i++) {
+      render_target *t = &pool->targets[i];
+      if (t->texture && pool->frame - t->last_used >= RENDER_TARGET_IDLE_FRAMES)
+         delete_target(pool, t);
+   }
+   for (i = 0; i < RENDER_FBO_CACHE_SIZE; i++) {
+      render_fbo *f = &pool->fbos[i];
+      if (f->fbo && pool->frame - f->last_used >= RENDER_TARGET_IDLE_FRAMES)
+         delete_fbo(f);
+   }
+   pool->frame++;
+}
@@ -0,0 +1,117 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+#include "gpu.h"
+
+#define RENDER_GRAPH_MAX_PASSES 16
+#define RENDER_GRAPH_MAX_RESOURCES 16
+#define RENDER_GRAPH_MAX_READS 4     // Textures one pass samples
+#define RENDER_TARGET_POOL_SIZE 16   // Pooled textures
+#define RENDER_FBO_CACHE_SIZE 16     // Framebuffers over pooled textures
+#define RENDER_TARGET_IDLE_FRAMES 60 // Frames unused before a pooled texture is freed
+
+enum render_format {
+   RENDER_FORMAT_RGBA8,
+   RENDER_FORMAT_RGBA16F,
+   RENDER_FORMAT_DEPTH24
+};
+
+// Textures behind transient graph resources, and framebuffers over them,
+// kept across frames. A texture is reused by any later resource of the same
+// size and format, in the same frame once its previous holder is dead or in
+// later frames, so steady frames create no GL objects. Textures left unused
+// for RENDER_TARGET_IDLE_FRAMES are freed along with their framebuffers.
+typedef struct render_target {
+   unsigned width, height, format;
+   GLuint texture; // 0 = empty slot
+   uint64_t last_used; // Pool frame
+   bool in_use;        // Held by a live resource of the executing graph
+} render_target;
+
+typedef struct render_fbo {
+   GLuint fbo, color, depth; // Attachments, 0 = none
+   uint64_t last_used;
+} render_fbo;
+
+typedef struct render_target_pool {
+   render_target targets[RENDER_TARGET_POOL_SIZE];
+   render_fbo fbos[RENDER_FBO_CACHE_SIZE];
+   uint64_t frame;
+   uint64_t created, freed; // Textures since init
+   const gpu_caps *caps;
+} render_target_pool;
+
+void render_target_pool_init(render_target_pool *pool, const gpu_caps *caps);
+// Deletes every pooled texture and framebuffer; needs the context current
+void render_target_pool_deinit(render_target_pool *pool);
+
+typedef int render_resource; // Index into the graph's resources
+#define RENDER_RESOURCE_NONE (-1)
+
+struct render_graph;
+// Runs with the pass's framebuffer bound and the viewport covering it.
+// Passes clear what they need cleared; contents of a transient target are
+// undefined on its first write.
+typedef void (*render_pass_fn)(void *user, const struct render_graph *graph);
+
+typedef struct render_graph_pass {
+   const char *name;
+   render_pass_fn fn;
+   void *user;
+   render_resource reads[RENDER_GRAPH_MAX_READS];
+   unsigned read_count;
+   render_resource color, depth; // Written attachments
+   bool live;                    // Contributes to an imported target
+} render_graph_pass;
+
+typedef struct render_graph_resource {
+   unsigned width, height, format;
+   bool imported; // A framebuffer owned outside the graph (e.g. the frontend's)
+   GLuint fbo;    // Imported framebuffer
+   int first, last; // Live passes touching it, -1 = none
+   int target;      // Pool slot while alive, -1 = none
+} render_graph_resource;
+
+// Per-frame description of a multi-pass frame: passes declare the targets
+// they sample and the attachments they write, in execution order. Passes
+// whose output never reaches an imported framebuffer are culled. Transient
+// targets only exist between their first and last live use; their
+// textures come from the pool, so targets whose lifetimes don't overlap
+// alias the same texture. Attachments are invalidated
+// (ARB_invalidate_subdata) on a target's first write, so no stale contents
+// are loaded, and after its last write when nothing reads it later.
+//
+// Fixed storage: building and executing a graph never allocates. Instance
+// thread only.
+typedef struct render_graph {
+   render_target_pool *pool;
+   render_graph_resource resources[RENDER_GRAPH_MAX_RESOURCES];
+   unsigned resource_count;
+   render_graph_pass passes[RENDER_GRAPH_MAX_PASSES];
+   unsigned pass_count;
+   bool overflowed; // Too many passes or resources; extra ones were dropped
+
+   // Last execution
+   unsigned executed, culled;
+   unsigned starved; // Live passes skipped because the pool was full
+} render_graph;
+
+void render_graph_begin(render_graph *graph, render_target_pool *pool);
+render_resource render_graph_import(render_graph *graph, GLuint fbo, unsigned width, unsigned height);
+render_resource render_graph_create(render_graph *graph, unsigned width, unsigned height, unsigned format);
+// Returns the pass index, -1 when full
+int render_graph_add_pass(render_graph *graph, const char *name, render_pass_fn fn, void *user);
+void render_graph_read(render_graph *graph, int pass, render_resource resource);
+// Either attachment may be RENDER_RESOURCE_NONE. An imported color target
+// brings its own depth buffer.
+void render_graph_write(render_graph *graph, int pass, render_resource color, render_resource depth);
+// Cull, allocate and run the passes in order
+void render_graph_execute(render_graph *graph);
+
+// Texture behind a transient resource, valid inside the passes that read it
+GLuint render_graph_texture(const render_graph *graph, render_resource resource);
+
+#endif // RENDER_GRAPH_H
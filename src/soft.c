@@ -0,0 +1,133 @@
+#include "soft.h"
+#include "tilemap.h"
+#include "alloc.h"
+#include <string.h>
+#include <math.h>
+
+bool soft_init(soft_renderer *soft, unsigned width, unsigned height) {
+   memset(soft, 0, sizeof(*soft));
+   soft->pixels = (uint32_t *)core_malloc((size_t)width * height * sizeof(uint32_t));
+   soft->depth = (float *)core_malloc((size_t)width * height * sizeof(float));
+   if (!soft->pixels || !soft->depth) {
+      soft_deinit(soft);
+      return false;
+   }
+   soft->width = width;
+   soft->height = height;
+   return true;
+}
+
+void soft_deinit(soft_renderer *soft) {
+   core_free(soft->pixels);
+   core_free(soft->depth);
+   memset(soft, 0, sizeof(*soft));
+}
+
+// First and one-past-last pixel whose center lies in [a, b), clamped to
+// [0, size): the rule GL rasterizes quads by
+static bool pixel_span(float a, float b, unsigned size, int *first, int *end) {
+   float lo = ceilf(a - 0.5f), hi = ceilf(b - 0.5f);
+   *first = lo < 0.0f ? 0 : lo > (float)size ? (int)size : (int)lo;
+   *end = hi < 0.0f ? 0 : hi > (float)size ? (int)size : (int)hi;
+   return *first < *end;
+}
+
+// Fill a rectangle with an RGBA8 color (red in the low byte) at depth,
+// depth-tested like GL_LEQUAL; write_depth in the opaque pass only
+static void fill_rect(soft_renderer *soft, float x, float y, float w, float h, uint32_t color,
+      float depth, unsigned blend, bool write_depth) {
+   uint32_t r = color & 0xff, g = (color >> 8) & 0xff, b = (color >> 16) & 0xff, a = color >> 24;
+   int x0, x1, y0, y1, px, py;
+   if (!pixel_span(x, x + w, soft->width, &x0, &x1) || !pixel_span(y, y + h, soft->height, &y0, &y1))
+      return;
+   if (blend != RENDER_BLEND_OPAQUE && a == 0)
+      return;
+
+   for (py = y0; py < y1; py++) {
+      uint32_t *row = soft->pixels + (size_t)py * soft->width;
+      float *zrow = soft->depth + (size_t)py * soft->width;
+      for (px = x0; px < x1; px++) {
+         uint32_t dst = row[px], dr, dg, db;
+         if (depth > zrow[px])
+            continue;
+         if (write_depth)
+            zrow[px] = depth;
+         dr = (dst >> 16) & 0xff;
+         dg = (dst >> 8) & 0xff;
+         db = dst & 0xff;
+         if (blend == RENDER_BLEND_OPAQUE) {
+            dr = r, dg = g, db = b;
+         } else if (blend == RENDER_BLEND_ADDITIVE) {
+            dr += (r * a + 127) / 255;
+            dg += (g * a + 127) / 255;
+            db += (b * a + 127) / 255;
+            dr = dr > 255 ? 255 : dr;
+            dg = dg > 255 ? 255 : dg;
+            db = db > 255 ? 255 : db;
+         } else {
+            dr = (r * a + dr * (255 - a) + 127) / 255;
+            dg = (g * a + dg * (255 - a) + 127) / 255;
+            db = (b * a + db * (255 - a) + 127) / 255;
+         }
+         row[px] = (dr << 16) | (dg << 8) | db;
+      }
+   }
+}
+
+// Each visible, non-empty tile as its own rectangle
+static void draw_tilemap(soft_renderer *soft, const render_command *cmd, unsigned blend, bool write_depth) {
+   const tilemap *map = cmd->u.tilemap.map;
+   float ts = map->tile_size, cam_x = cmd->u.tilemap.cam_x, cam_y = cmd->u.tilemap.cam_y;
+   float depth = RENDER_PAINT_DEPTH(cmd->paint);
+   int tx0 = (int)floorf(cam_x / ts), ty0 = (int)floorf(cam_y / ts);
+   int tx1 = (int)floorf((cam_x + soft->width) / ts), ty1 = (int)floorf((cam_y + soft->height) / ts);
+   int tx, ty;
+   if (!map->tiles)
+      return;
+   tx0 = tx0 < 0 ? 0 : tx0;
+   ty0 = ty0 < 0 ? 0 : ty0;
+   tx1 = tx1 >= (int)map->width ? (int)map->width - 1 : tx1;
+   ty1 = ty1 >= (int)map->height ? (int)map->height - 1 : ty1;
+   for (ty = ty0; ty <= ty1; ty++) {
+      for (tx = tx0; tx <= tx1; tx++) {
+         uint8_t id = map->tiles[(size_t)ty * map->width + tx];
+         if (id)
+            fill_rect(soft, tx * ts - cam_x, ty * ts - cam_y, ts, ts, map->palette[id], depth, blend, write_depth);
+      }
+   }
+}
+
+void soft_render(soft_renderer *soft, const command_buffer *cb, const float clear_color[4]) {
+   uint32_t clear = ((uint32_t)(clear_color[0] * 255.0f + 0.5f) << 16) |
+         ((uint32_t)(clear_color[1] * 255.0f + 0.5f) << 8) | (uint32_t)(clear_color[2] * 255.0f + 0.5f);
+   size_t i, n = (size_t)soft->width * soft->height;
+   for (i = 0; i < n; i++) {
+      soft->pixels[i] = clear;
+      soft->depth[i] = 1.0f;
+   }
+
+   for (i = 0; i < cb->num_batches; i++) {
+      const render_batch *batch = &cb->batches[i];
+      unsigned blend = RENDER_STATE_BLEND(batch->state);
+      bool opaque = RENDER_STATE_PASS(batch->state) == RENDER_PASS_OPAQUE;
+      if (batch->instanced) {
+         const quad_streams *s = &batch->streams;
+         unsigned k;
+         if (s->uv) { // SDF glyphs need the atlas texture
+            soft->skipped++;
+            continue;
+         }
+         for (k = 0; k < s->count; k++)
+            fill_rect(soft, s->x[k] - s->w[k] * 0.5f, s->y[k] - s->h[k] * 0.5f, s->w[k], s->h[k], s->color[k],
+                  s->depth ? s->depth[k] : s->const_depth, blend, opaque);
+      } else if (batch->single->type == RENDER_CMD_QUAD) {
+         const render_command *cmd = batch->single;
+         fill_rect(soft, cmd->u.quad.x, cmd->u.quad.y, cmd->u.quad.w, cmd->u.quad.h, cmd->u.quad.color,
+               RENDER_PAINT_DEPTH(cmd->paint), blend, opaque);
+      } else if (batch->single->type == RENDER_CMD_TILEMAP) {
+         draw_tilemap(soft, batch->single, blend, opaque);
+      } else {
+         soft->skipped++;
+      }
+   }
+}
@@ -0,0 +1,29 @@
+#ifndef SOFT_H
+#define SOFT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "commands.h"
+
+// Software renderer, the last rung of the context ladder: replays a frame's
+// batches into a CPU framebuffer by the rules the GL path follows. The
+// opaque pass tests and writes depth; the translucent pass, already in
+// paint order, only tests it. Solid quads, quad streams and tilemaps are
+// drawn. SDF text, particles and vector paths live in GPU objects and are
+// skipped, as are debug shapes and post effects. No GL calls; runs on the
+// instance thread.
+typedef struct soft_renderer {
+   unsigned width, height;
+   uint32_t *pixels; // XRGB8888, top row first, pitch = width * 4
+   float *depth;     // Window-space depth per pixel, cleared to 1
+   uint64_t skipped; // Commands without a software path, since init
+} soft_renderer;
+
+bool soft_init(soft_renderer *soft, unsigned width, unsigned height);
+void soft_deinit(soft_renderer *soft);
+
+// Clear to clear_color (RGBA, 0 to 1) and draw the batches of cb, which
+// must be finished
+void soft_render(soft_renderer *soft, const command_buffer *cb, const float clear_color[4]);
+
+#endif // SOFT_H
@@ -0,0 +1,166 @@
+#include "spatial_grid.h"
+#include "alloc.h"
+#include <string.h>
+
+#define NO_CELL UINT32_MAX
+
+static unsigned clamp_cell(float v, float inv_cell_size, unsigned count) {
+   float c = v * inv_cell_size;
+   if (c <= 0.0f)
+      return 0;
+   if (c >= (float)count)
+      return count - 1;
+   return (unsigned)c;
+}
+
+static uint32_t cell_of(const spatial_grid *grid, float x, float y) {
+   return clamp_cell(y, grid->inv_cell_size, grid->rows) * grid->cols +
+         clamp_cell(x, grid->inv_cell_size, grid->cols);
+}
+
+bool spatial_grid_init(spatial_grid *grid, float world_w, float world_h, float cell_size,
+      float margin, unsigned capacity) {
+   unsigned i;
+   memset(grid, 0, sizeof(*grid));
+   if (cell_size <= 0.0f || !capacity)
+      return false;
+   grid->cell_size = cell_size;
+   grid->inv_cell_size = 1.0f / cell_size;
+   grid->margin = margin;
+   grid->cols = world_w > cell_size ? (unsigned)(world_w / cell_size + 0.999f) : 1;
+   grid->rows = world_h > cell_size ? (unsigned)(world_h / cell_size + 0.999f) : 1;
+   grid->capacity = capacity;
+
+   grid->heads = (int32_t *)core_malloc((size_t)grid->cols * grid->rows * sizeof(int32_t));
+   grid->block = core_malloc((size_t)capacity * 3 * sizeof(int32_t));
+   if (!grid->heads || !grid->block) {
+      spatial_grid_deinit(grid);
+      return false;
+   }
+   grid->next = (int32_t *)grid->block;
+   grid->prev = grid->next + capacity;
+   grid->cell = (uint32_t *)(grid->prev + capacity);
+   for (i = 0; i < grid->cols * grid->rows; i++)
+      grid->heads[i] = -1;
+   for (i = 0; i < capacity; i++)
+      grid->cell[i] = NO_CELL;
+   return true;
+}
+
+void spatial_grid_deinit(spatial_grid *grid) {
+   core_free(grid->heads);
+   core_free(grid->block);
+   memset(grid, 0, sizeof(*grid));
+}
+
+static void link(spatial_grid *grid, unsigned id, uint32_t cell) {
+   int32_t head = grid->heads[cell];
+   grid->next[id] = head;
+   grid->prev[id] = -1;
+   if (head >= 0)
+      grid->prev[head] = (int32_t)id;
+   grid->heads[cell] = (int32_t)id;
+   grid->cell[id] = cell;
+}
+
+static void unlink(spatial_grid *grid, unsigned id) {
+   int32_t next = grid->next[id], prev = grid->prev[id];
+   if (prev >= 0)
+      grid->next[prev] = next;
+   else
+      grid->heads[grid->cell[id]] = next;
+   if (next >= 0)
+      grid->prev[next] = prev;
+   grid->cell[id] = NO_CELL;
+}
+
+void spatial_grid_insert(spatial_grid *grid, unsigned id, float x, float y) {
+   if (id >= grid->capacity)
+      return;
+   if (grid->cell[id] != NO_CELL)
+      unlink(grid, id);
+   link(grid, id, cell_of(grid, x, y));
+}
+
+void spatial_grid_remove(spatial_grid *grid, unsigned id) {
+   if (id < grid->capacity && grid->cell[id] != NO_CELL)
+      unlink(grid, id);
+}
+
+void spatial_grid_move(spatial_grid *grid, unsigned id, float x, float y) {
+   uint32_t cell;
+   if (id >= grid->capacity || grid->cell[id] == NO_CELL)
+      return;
+   cell = cell_of(grid, x, y);
+   if (cell == grid->cell[id])
+      return;
+   unlink(grid, id);
+   link(grid, id, cell);
+   grid->relinks++;
+}
+
+void spatial_grid_update(spatial_grid *grid, const float *x, const float *y, unsigned count) {
+   unsigned i;
+   if (count > grid->capacity)
+      count = grid->capacity;
+   for (i = 0; i < count; i++) {
+      uint32_t cell = cell_of(grid, x[i], y[i]);
+      if (cell != grid->cell[i] && grid->cell[i] != NO_CELL) {
+         unlink(grid, i);
+         link(grid, i, cell);
+         grid->relinks++;
+      }
+   }
+}
+
+// Cells that can hold an object overlapping [x0, x1) x [y0, y1)
+static void cell_range(const spatial_grid *grid, float x0, float y0, float x1, float y1,
+      unsigned *cx0, unsigned *cy0, unsigned *cx1, unsigned *cy1) {
+   *cx0 = clamp_cell(x0 - grid->margin, grid->inv_cell_size, grid->cols);
+   *cy0 = clamp_cell(y0 - grid->margin, grid->inv_cell_size, grid->rows);
+   *cx1 = clamp_cell(x1 + grid->margin, grid->inv_cell_size, grid->cols);
+   *cy1 = clamp_cell(y1 + grid->margin, grid->inv_cell_size, grid->rows);
+}
+
+unsigned spatial_grid_query(const spatial_grid *grid, float x0, float y0, float x1, float y1,
+      const float *x, const float *y, const float *w, const float *h,
+      uint32_t *out, unsigned max_out) {
+   unsigned cx0, cy0, cx1, cy1, cx, cy, n = 0;
+   if (!grid->heads)
+      return 0;
+   cell_range(grid, x0, y0, x1, y1, &cx0, &cy0, &cx1, &cy1);
+   for (cy = cy0; cy <= cy1; cy++) {
+      for (cx = cx0; cx <= cx1; cx++) {
+         int32_t id;
+         for (id = grid->heads[cy * grid->cols + cx]; id >= 0; id = grid->next[id]) {
+            float hw = w[id] * 0.5f, hh = h[id] * 0.5f;
+            if (x[id] + hw <= x0 || x[id] - hw >= x1 || y[id] + hh <= y0 || y[id] - hh >= y1)
+               continue;
+            if (n == max_out)
+               return n;
+            out[n++] = (uint32_t)id;
+         }
+      }
+   }
+   return n;
+}
+
+int spatial_grid_pick(const spatial_grid *grid, float px, float py,
+      const float *x, const float *y, const float *w, const float *h) {
+   unsigned cx0, cy0, cx1, cy1, cx, cy;
+   int32_t best = -1;
+   if (!grid->heads)
+      return -1;
+   cell_range(grid, px, py, px, py, &cx0, &cy0, &cx1, &cy1);
+   for (cy = cy0; cy <= cy1; cy++) {
+      for (cx = cx0; cx <= cx1; cx++) {
+         int32_t id;
+         for (id = grid->heads[cy * grid->cols + cx]; id >= 0; id = grid->next[id]) {
+            if (id > best && px >= x[id] - w[id] * 0.5f && px < x[id] + w[id] * 0.5f &&
+                  py >= y[id] - h[id] * 0.5f && py < y[id] + h[id] * 0.5f)
+               best = id;
+         }
+      }
+   }
+   return best;
+}
@@ -0,0 +1,50 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Loose uniform grid over dynamic 2D objects identified by index (the
+// entity store's indices, say). Each object lives in the one cell holding
+// its center and cells are linked lists threaded through per-object
+// arrays, so moving an object is O(1) and only relinks when it crosses a
+// cell edge. Queries widen the rectangle by the loose margin, the largest
+// half extent any object may have, and then visit only the overlapping
+// cells: the cost follows what is near the query, not the object count.
+//
+// Not thread-safe; updates and queries come from one thread at a time.
+typedef struct spatial_grid {
+   float cell_size, inv_cell_size;
+   float margin;        // Largest object half extent
+   unsigned cols, rows; // Cells covering the world; outside clamps to the edge
+   int32_t *heads;      // First object per cell, -1 if empty
+   int32_t *next, *prev;
+   uint32_t *cell;      // Cell per object, UINT32_MAX when not inserted
+   unsigned capacity;
+   void *block;         // Single allocation backing the per-object arrays
+   uint64_t relinks;    // Cell changes since init
+} spatial_grid;
+
+bool spatial_grid_init(spatial_grid *grid, float world_w, float world_h, float cell_size,
+      float margin, unsigned capacity);
+void spatial_grid_deinit(spatial_grid *grid);
+
+// id must be below capacity
+void spatial_grid_insert(spatial_grid *grid, unsigned id, float x, float y);
+void spatial_grid_remove(spatial_grid *grid, unsigned id);
+void spatial_grid_move(spatial_grid *grid, unsigned id, float x, float y);
+// Move objects [0, count) to their current centers
+void spatial_grid_update(spatial_grid *grid, const float *x, const float *y, unsigned count);
+
+// Write the ids of objects whose box (center x/y, size w/h) overlaps
+// [x0, x1) x [y0, y1) to out, up to max_out; returns how many were found
+unsigned spatial_grid_query(const spatial_grid *grid, float x0, float y0, float x1, float y1,
+      const float *x, const float *y, const float *w, const float *h,
+      uint32_t *out, unsigned max_out);
+
+// Highest id whose box contains the point (the topmost one when ids draw
+// in increasing order), or -1
+int spatial_grid_pick(const spatial_grid *grid, float px, float py,
+      const float *x, const float *y, const float *w, const float *h);
+
+#endif // SPATIAL_GRID_H
@@ -0,0 +1,505 @@
+#include "text.h"
+#include "core.h"
+#include "alloc.h"
+#include <string.h>
+#include <math.h>
+
+#define FONT_SIZE 8         // Embedded font: 8x8 pixels per glyph
+#define FONT_SCALE 3        // Atlas texels per font pixel
+#define FONT_PAD 4          // Texels around the glyph box in a slot
+#define SDF_SPREAD 4        // Texels of distance the field encodes either way
+#define TEXT_LINE_HEIGHT 10 // Font pixels
+#define NO_CODEPOINT UINT32_MAX
+
+// Printable ASCII, U+0020..U+007E, one byte per row, bit 0 leftmost
+// (public domain font8x8_basic)
+static const uint8_t font8x8[95][8] = {
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+   { 0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00 }, // !
+   { 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // "
+   { 0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00 }, // #
+   { 0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00 }, // $
+   { 0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00 }, // %
+   { 0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00 }, // &
+   { 0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '
+   { 0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00 }, // (
+   { 0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00 }, // )
+   { 0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00 }, // *
+   { 0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00 }, // +
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06 }, // ,
+   { 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00 }, // -
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00 }, // .
+   { 0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00 }, // /
+   { 0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00 }, // 0
+   { 0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00 }, // 1
+   { 0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00 }, // 2
+   { 0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00 }, // 3
+   { 0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00 }, // 4
+   { 0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00 }, // 5
+   { 0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00 }, // 6
+   { 0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00 }, // 7
+   { 0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00 }, // 8
+   { 0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00 }, // 9
+   { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00 }, // :
+   { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06 }, // ;
+   { 0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00 }, // <
+   { 0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00 }, // =
+   { 0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00 }, // >
+   { 0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00 }, // ?
+   { 0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00 }, // @
+   { 0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00 }, // A
+   { 0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00 }, // B
+   { 0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00 }, // C
+   { 0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00 }, // D
+   { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00 }, // E
+   { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00 }, // F
+   { 0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00 }, // G
+   { 0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00 }, // H
+   { 0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 }, // I
+   { 0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00 }, // J
+   { 0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00 }, // K
+   { 0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00 }, // L
+   { 0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00 }, // M
+   { 0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00 }, // N
+   { 0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00 }, // O
+   { 0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00 }, // P
+   { 0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00 }, // Q
+   { 0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00 }, // R
+   { 0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00 }, // S
+   { 0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 }, // T
+   { 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00 }, // U
+   { 0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 }, // V
+   { 0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00 }, // W
+   { 0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00 }, // X
+   { 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00 }, // Y
+   { 0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00 }, // Z
+   { 0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00 }, // [
+   { 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00 }, // backslash
+   { 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00 }, // ]
+   { 0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00 }, // ^
+   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF }, // _
+   { 0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 }, // `
+   { 0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00 }, // a
+   { 0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00 }, // b
+   { 0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00 }, // c
+   { 0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00 }, // d
+   { 0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00 }, // e
+   { 0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00 }, // f
+   { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F }, // g
+   { 0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00 }, // h
+   { 0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 }, // i
+   { 0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E }, // j
+   { 0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00 }, // k
+   { 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 }, // l
+   { 0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00 }, // m
+   { 0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00 }, // n
+   { 0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00 }, // o
+   { 0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F }, // p
+   { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78 }, // q
+   { 0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00 }, // r
+   { 0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00 }, // s
+   { 0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00 }, // t
+   { 0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00 }, // u
+   { 0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 }, // v
+   { 0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00 }, // w
+   { 0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00 }, // x
+   { 0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F }, // y
+   { 0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00 }, // z
+   { 0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00 }, // {
+   { 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00 }, // |
+   { 0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00 }, // }
+   { 0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ~
+};
+
+// Drawn for codepoints the font lacks; each still gets its own slot, as a
+// font with wider coverage would give it
+static const uint8_t missing_glyph[8] = { 0x00, 0x7E, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x00 };
+
+static const uint8_t *glyph_bitmap(uint32_t cp) {
+   if (cp >= 0x20 && cp <= 0x7e)
+      return font8x8[cp - 0x20];
+   return missing_glyph;
+}
+
+// Distance field of one glyph into a TEXT_CELL square at dst. 0.5 (128)
+// is the outline, higher is inside; each step of 1/(2 * SDF_SPREAD) is one
+// texel. Distances are searched within SDF_SPREAD texels, which is all
+// the field can encode anyway.
+static void rasterize_glyph(uint32_t cp, uint8_t *dst, size_t pitch) {
+   const uint8_t *rows = glyph_bitmap(cp);
+   uint8_t mask[TEXT_CELL][TEXT_CELL];
+   int x, y, dx, dy;
+   for (y = 0; y < TEXT_CELL; y++) {
+      for (x = 0; x < TEXT_CELL; x++) {
+         int fx = (x - FONT_PAD) / FONT_SCALE, fy = (y - FONT_PAD) / FONT_SCALE;
+         mask[y][x] = x >= FONT_PAD && y >= FONT_PAD && fx < FONT_SIZE && fy < FONT_SIZE &&
+               ((rows[fy] >> fx) & 1);
+      }
+   }
+   for (y = 0; y < TEXT_CELL; y++) {
+      for (x = 0; x < TEXT_CELL; x++) {
+         int best = (SDF_SPREAD + 1) * (SDF_SPREAD + 1);
+         float d, v;
+         for (dy = -SDF_SPREAD; dy <= SDF_SPREAD; dy++) {
+            for (dx = -SDF_SPREAD; dx <= SDF_SPREAD; dx++) {
+               int sx = x + dx, sy = y + dy;
+               // Outside the slot counts as outside the glyph
+               uint8_t other = sx >= 0 && sy >= 0 && sx < TEXT_CELL && sy < TEXT_CELL ? mask[sy][sx] : 0;
+               if (other != mask[y][x] && dx * dx + dy * dy < best)
+                  best = dx * dx + dy * dy;
+            }
+         }
+         // Center-to-center distance, less half a texel to reach the edge
+         d = sqrtf((float)best) - 0.5f;
+         if (d > SDF_SPREAD)
+            d = SDF_SPREAD;
+         v = 0.5f + (mask[y][x] ? d : -d) * (0.5f / SDF_SPREAD);
+         dst[(size_t)y * pitch + x] = (uint8_t)(v <= 0.0f ? 0 : v >= 1.0f ? 255 : v * 255.0f + 0.5f);
+      }
+   }
+}
+
+static uint8_t *slot_pixels(text_renderer *text, unsigned slot) {
+   return text->atlas + (size_t)(slot / TEXT_ATLAS_COLS) * TEXT_CELL * TEXT_ATLAS_SIZE +
+         (slot % TEXT_ATLAS_COLS) * TEXT_CELL;
+}
+
+// Top-left of the drawn part of a slot as two unsigned normalized 16-bit
+// coordinates
+static uint32_t slot_uv(unsigned slot) {
+   const float inset = (TEXT_CELL - TEXT_GLYPH_TEXELS) * 0.5f;
+   float u = ((slot % TEXT_ATLAS_COLS) * TEXT_CELL + inset) / TEXT_ATLAS_SIZE;
+   float v = ((slot / TEXT_ATLAS_COLS) * TEXT_CELL + inset) / TEXT_ATLAS_SIZE;
+   return (uint32_t)(u * 65535.0f + 0.5f) | ((uint32_t)(v * 65535.0f + 0.5f) << 16);
+}
+
+static void assign_slot(text_renderer *text, unsigned slot, uint32_t cp) {
+   text->slot_codepoint[slot] = cp;
+   if (cp < 128)
+      text->ascii_slot[cp] = (int16_t)slot;
+   rasterize_glyph(cp, slot_pixels(text, slot), TEXT_ATLAS_SIZE);
+   text->rasterized++;
+}
+
+bool text_init(text_renderer *text) {
+   unsigned i;
+   uint32_t cp;
+   memset(text, 0, sizeof(*text));
+   text->atlas = (uint8_t *)core_calloc((size_t)TEXT_ATLAS_SIZE * TEXT_ATLAS_SIZE, 1);
+   text->layouts = (text_layout *)core_calloc(TEXT_LAYOUT_CACHE, sizeof(text_layout));
+   if (!text->atlas || !text->layouts) {
+      text_deinit(text);
+      return false;
+   }
+   for (i = 0; i < 128; i++)
+      text->ascii_slot[i] = -1;
+   for (i = 0; i < TEXT_ATLAS_SLOTS; i++)
+      text->slot_codepoint[i] = NO_CODEPOINT;
+   // Space only advances the pen
+   for (cp = 0x21; cp <= 0x7e; cp++)
+      assign_slot(text, text->slot_count++, cp);
+   return true;
+}
+
+void text_deinit(text_renderer *text) {
+   text_gl_deinit(text);
+   core_free(text->atlas);
+   core_free(text->layouts);
+   memset(text, 0, sizeof(*text));
+}
+
+bool text_gl_init(core_t *core, text_renderer *text) {
+   glGenTextures(1, &text->texture);
+   glBindTexture(GL_TEXTURE_2D, text->texture);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, TEXT_ATLAS_SIZE, TEXT_ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, text->atlas);
+   glBindTexture(GL_TEXTURE_2D, 0);
+   core_check_gl_error(core, "text_gl_init");
+   return text->texture != 0;
+}
+
+void text_gl_deinit(text_renderer *text) {
+   if (text->texture)
+      glDeleteTextures(1, &text->texture);
+   text->texture = 0;
+}
+
+// Queue a slot's pixels for upload with the frame
+static bool record_upload(text_frame *frame, unsigned slot) {
+   const uint8_t *src = slot_pixels(frame->text, slot);
+   uint8_t *pixels;
+   unsigned y;
+   if (frame->upload_count == frame->upload_capacity) {
+      unsigned capacity = frame->upload_capacity ? frame->upload_capacity * 2 : 16;
+      glyph_upload *uploads = (glyph_upload *)frame_arena_alloc(frame->arena, capacity * sizeof(glyph_upload));
+      if (!uploads)
+         return false;
+      if (frame->upload_count)
+         memcpy(uploads, frame->uploads, frame->upload_count * sizeof(glyph_upload));
+      frame->uploads = uploads;
+      frame->upload_capacity = capacity;
+   }
+   if (!(pixels = (uint8_t *)frame_arena_alloc(frame->arena, TEXT_CELL * TEXT_CELL)))
+      return false;
+   for (y = 0; y < TEXT_CELL; y++)
+      memcpy(pixels + y * TEXT_CELL, src + (size_t)y * TEXT_ATLAS_SIZE, TEXT_CELL);
+   frame->uploads[frame->upload_count].slot = (uint16_t)slot;
+   frame->uploads[frame->upload_count].pixels = pixels;
+   frame->upload_count++;
+   return true;
+}
+
+// A free slot, else the least recently drawn one not drawn this frame; -1
+// when every slot is in use by the frame
+static int take_slot(text_renderer *text) {
+   unsigned i;
+   int victim = -1;
+   uint32_t cp;
+   if (text->slot_count < TEXT_ATLAS_SLOTS)
+      return (int)text->slot_count++;
+   for (i = 0; i < TEXT_ATLAS_SLOTS; i++) {
+      if (text->slot_used[i] < text->frame && (victim < 0 || text->slot_used[i] < text->slot_used[victim]))
+         victim = (int)i;
+   }
+   if (victim < 0)
+      return -1;
+   cp = text->slot_codepoint[victim];
+   if (cp < 128)
+      text->ascii_slot[cp] = -1;
+   text->slot_codepoint[victim] = NO_CODEPOINT;
+   text->generation++;
+   text->evictions++;
+   return victim;
+}
+
+// Slot holding cp, rasterizing it on a miss; -1 if it can't be had
+static int glyph_slot(text_frame *frame, uint32_t cp) {
+   text_renderer *text = frame->text;
+   int slot = -1;
+   unsigned i;
+   if (cp < 128) {
+      slot = text->ascii_slot[cp];
+   } else {
+      // Non-ASCII is rare enough that a scan beats keeping a map in sync
+      for (i = 0; i < text->slot_count; i++) {
+         if (text->slot_codepoint[i] == cp) {
+            slot = (int)i;
+            break;
+         }
+      }
+   }
+   if (slot < 0) {
+      if ((slot = take_slot(text)) < 0)
+         return -1;
+      assign_slot(text, (unsigned)slot, cp);
+      if (!record_upload(frame, (unsigned)slot)) {
+         if (cp < 128)
+            text->ascii_slot[cp] = -1;
+         text->slot_codepoint[slot] = NO_CODEPOINT;
+         return -1;
+      }
+   }
+   text->slot_used[slot] = text->frame;
+   return slot;
+}
+
+// Next codepoint of UTF-8 text; a malformed sequence decodes as U+FFFD
+// and skips one byte
+static uint32_t next_codepoint(const unsigned char **s, const unsigned char *end) {
+   const unsigned char *p = *s;
+   uint32_t cp = *p++, min;
+   unsigned extra, i;
+   if (cp < 0x80) {
+      *s = p;
+      return cp;
+   }
+   if ((cp & 0xe0) == 0xc0)
+      extra = 1, cp &= 0x1f, min = 0x80;
+   else if ((cp & 0xf0) == 0xe0)
+      extra = 2, cp &= 0x0f, min = 0x800;
+   else if ((cp & 0xf8) == 0xf0)
+      extra = 3, cp &= 0x07, min = 0x10000;
+   else
+      extra = 0, min = UINT32_MAX;
+   for (i = 0; i < extra; i++) {
+      if (p == end || (*p & 0xc0) != 0x80)
+         break;
+      cp = (cp << 6) | (*p++ & 0x3f);
+   }
+   if (i < extra || cp < min || cp > 0x10ffff) {
+      *s = *s + 1;
+      return 0xfffd;
+   }
+   *s = p;
+   return cp;
+}
+
+// Decode and place a string's glyphs; returns how many were written
+static unsigned layout_text(text_frame *frame, const char *str, size_t len, text_glyph *out) {
+   const unsigned char *s = (const unsigned char *)str, *end = s + len;
+   int pen_x = 0, pen_y = 0;
+   unsigned n = 0;
+   while (s < end) {
+      uint32_t cp = next_codepoint(&s, end);
+      int slot;
+      if (cp == '\n') {
+         pen_x = 0;
+         pen_y += TEXT_LINE_HEIGHT;
+         continue;
+      }
+      if (cp != ' ' && (slot = glyph_slot(frame, cp)) >= 0) {
+         out[n].x = (int16_t)pen_x;
+         out[n].y = (int16_t)pen_y;
+         out[n].slot = (uint16_t)slot;
+         n++;
+      }
+      pen_x += FONT_SIZE;
+   }
+   return n;
+}
+
+static uint64_t hash_text(const char *str, size_t len) {
+   uint64_t h = 0xcbf29ce484222325ull;
+   size_t i;
+   for (i = 0; i < len; i++)
+      h = (h ^ (unsigned char)str[i]) * 0x100000001b3ull;
+   return h;
+}
+
+// Cached layout of str, laid out again if missing or if an eviction may
+// have taken one of its slots. Probes four entries and replaces the least
+// recently used on a miss.
+static const text_layout *cached_layout(text_frame *frame, const char *str, size_t len) {
+   text_renderer *text = frame->text;
+   uint64_t h = hash_text(str, len);
+   text_layout *entry = NULL;
+   bool found = false;
+   unsigned i;
+   for (i = 0; i < 4 && !found; i++) {
+      text_layout *l = &text->layouts[(h + i) & (TEXT_LAYOUT_CACHE - 1)];
+      found = l->last_used && l->hash == h && l->length == len && !memcmp(l->text, str, len);
+      if (found || !entry || l->last_used < entry->last_used)
+         entry = l;
+   }
+   if (found && entry->generation == text->generation) {
+      entry->last_used = text->frame;
+      text->layout_hits++;
+      return entry;
+   }
+   entry->hash = h;
+   entry->length = (unsigned)len;
+   memcpy(entry->text, str, len);
+   entry->glyph_count = layout_text(frame, str, len, entry->glyphs);
+   entry->generation = text->generation;
+   entry->last_used = text->frame;
+   text->layout_misses++;
+   return entry;
+}
+
+// Record the current stream, if any
+static void flush(text_frame *frame) {
+   quad_streams streams;
+   if (!frame->count)
+      return;
+   memset(&streams, 0, sizeof(streams));
+   streams.count = frame->count;
+   streams.x = frame->x;
+   streams.y = frame->y;
+   streams.w = frame->w;
+   streams.h = frame->h;
+   streams.color = frame->color;
+   streams.uv = frame->uv;
+   command_buffer_push_streams(frame->cb, frame->layer, RENDER_PROGRAM_TEXT, frame->text->texture,
+         RENDER_BLEND_ALPHA, &streams);
+   frame->count = 0;
+}
+
+static bool reserve_stream(text_frame *frame) {
+   size_t bytes = TEXT_BATCH_GLYPHS * sizeof(float);
+   unsigned char *block;
+   if (frame->x && frame->count < TEXT_BATCH_GLYPHS)
+      return true;
+   flush(frame);
+   if (!(block = (unsigned char *)frame_arena_alloc(frame->arena, bytes * 6))) {
+      frame->x = NULL;
+      return false;
+   }
+   frame->x = (float *)block;
+   frame->y = (float *)(block + bytes);
+   frame->w = (float *)(block + bytes * 2);
+   frame->h = (float *)(block + bytes * 3);
+   frame->color = (uint32_t *)(block + bytes * 4);
+   frame->uv = (uint32_t *)(block + bytes * 5);
+   return true;
+}
+
+void text_begin(text_frame *frame, text_renderer *text, frame_arena *arena,
+      command_buffer *cb, unsigned layer) {
+   memset(frame, 0, sizeof(*frame));
+   frame->text = text;
+   frame->arena = arena;
+   frame->cb = cb;
+   frame->layer = layer;
+   text->frame++;
+}
+
+void text_draw(text_frame *frame, const char *str, float x, float y, float size, uint32_t color) {
+   text_renderer *text = frame->text;
+   size_t len = strlen(str);
+   const text_glyph *glyphs;
+   unsigned count, i;
+   // Quads are centered on the glyph box: center = origin + (box + 4) * k
+   float k = size / FONT_SIZE;
+   float extent = (float)TEXT_GLYPH_TEXELS / FONT_SCALE * k;
+   float offset = FONT_SIZE * 0.5f * k;
+   if (!len || !text->atlas)
+      return;
+   if (len <= TEXT_LAYOUT_MAX_BYTES) {
+      const text_layout *layout = cached_layout(frame, str, len);
+      glyphs = layout->glyphs;
+      count = layout->glyph_count;
+   } else {
+      text_glyph *scratch = (text_glyph *)frame_arena_alloc(frame->arena, len * sizeof(text_glyph));
+      if (!scratch)
+         return;
+      count = layout_text(frame, str, len, scratch);
+      glyphs = scratch;
+   }
+
+   for (i = 0; i < count; i++) {
+      unsigned n;
+      if (!reserve_stream(frame))
+         return;
+      n = frame->count++;
+      frame->x[n] = x + glyphs[i].x * k + offset;
+      frame->y[n] = y + glyphs[i].y * k + offset;
+      frame->w[n] = extent;
+      frame->h[n] = extent;
+      frame->color[n] = color;
+      frame->uv[n] = slot_uv(glyphs[i].slot);
+      // Keep cached glyphs recent so eviction leaves them alone
+      text->slot_used[glyphs[i].slot] = text->frame;
+   }
+   frame->glyphs += count;
+}
+
+void text_end(text_frame *frame) {
+   flush(frame);
+}
+
+void text_apply_uploads(text_renderer *text, const gpu_caps *caps, const glyph_upload *uploads, unsigned count) {
+   unsigned i;
+   if (!text->texture || !count)
+      return;
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   for (i = 0; i < count; i++) {
+      unsigned slot = uploads[i].slot;
+      gpu_texture_update(caps, text->texture, (GLint)(slot % TEXT_ATLAS_COLS) * TEXT_CELL,
+            (GLint)(slot / TEXT_ATLAS_COLS) * TEXT_CELL, TEXT_CELL, TEXT_CELL, GL_RED, GL_UNSIGNED_BYTE,
+            uploads[i].pixels);
+   }
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
@@ -0,0 +1,117 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <glad/glad.h>
+#include "arena.h"
+#include "commands.h"
+#include "gpu.h"
+
+#define TEXT_CELL 32        // Atlas texels per glyph slot side
+#define TEXT_ATLAS_SIZE 512 // Atlas side, texels
+#define TEXT_ATLAS_COLS (TEXT_ATLAS_SIZE / TEXT_CELL)
+#define TEXT_ATLAS_SLOTS (TEXT_ATLAS_COLS * TEXT_ATLAS_COLS)
+// Part of a slot a glyph quad covers: the 24-texel glyph box and a margin
+// wide enough for antialiasing, not the whole padded slot
+#define TEXT_GLYPH_TEXELS 27
+#define TEXT_GLYPH_UV ((float)TEXT_GLYPH_TEXELS / TEXT_ATLAS_SIZE)
+
+#define TEXT_LAYOUT_CACHE 128    // Cached string layouts
+#define TEXT_LAYOUT_MAX_BYTES 96 // Longer strings are laid out every draw
+#define TEXT_BATCH_GLYPHS 4096   // Instances per recorded stream
+
+// Signed-distance-field text. Glyphs come from an embedded 8x8 bitmap
+// font: each one is upscaled and turned into a distance field in a 32x32
+// slot of a single-channel atlas, so it stays sharp at any size and
+// costs one texel fetch and a smoothstep per pixel. Printable ASCII is
+// rasterized at init; any other codepoint gets a slot when first drawn,
+// evicting the least recently drawn glyph once the atlas is full (never
+// one drawn in the current frame).
+//
+// Laying out a string (decoding, atlas lookups, pen advance) is cached per
+// string content, so text that doesn't change between frames only costs a
+// copy of its glyphs into the frame's instance streams. Glyphs become
+// quad_batch instances with atlas coordinates, drawn by its SDF program in
+// the translucent pass.
+//
+// Atlas bookkeeping and layouts belong to the simulation; the texture to
+// the instance thread. New glyphs are copied into the frame arena and
+// uploaded by text_apply_uploads() when the frame is submitted.
+typedef struct text_glyph {
+   int16_t x, y;  // Top-left of the glyph's 8x8 box, font pixels from the origin
+   uint16_t slot; // Atlas slot
+} text_glyph;
+
+typedef struct text_layout {
+   uint64_t hash;
+   uint64_t last_used;  // Frame, 0 = empty
+   uint32_t generation; // Atlas generation the slots refer to
+   unsigned length;
+   unsigned glyph_count;
+   char text[TEXT_LAYOUT_MAX_BYTES];
+   text_glyph glyphs[TEXT_LAYOUT_MAX_BYTES]; // At most one glyph per byte
+} text_layout;
+
+// A glyph rasterized by the simulation, waiting for its texture upload
+typedef struct glyph_upload {
+   uint16_t slot;
+   const uint8_t *pixels; // TEXT_CELL * TEXT_CELL distance values, frame arena
+} glyph_upload;
+
+typedef struct text_renderer {
+   uint8_t *atlas; // CPU copy of the texture, uploaded whole by text_gl_init()
+   uint32_t slot_codepoint[TEXT_ATLAS_SLOTS];
+   uint64_t slot_used[TEXT_ATLAS_SLOTS]; // Frame a slot was last drawn
+   int16_t ascii_slot[128];              // Slot per ASCII codepoint, -1 if none
+   unsigned slot_count;                  // Slots handed out so far
+   uint32_t generation;                  // Bumped by evictions; stales layouts
+   uint64_t frame;
+   text_layout *layouts;
+
+   GLuint texture; // Created by text_gl_init() in a current context
+
+   uint64_t rasterized, evictions; // Glyphs since init
+   uint64_t layout_hits, layout_misses;
+} text_renderer;
+
+// Recording state for one frame's text
+typedef struct text_frame {
+   text_renderer *text;
+   frame_arena *arena;
+   command_buffer *cb;
+   unsigned layer;
+   float *x, *y, *w, *h;
+   uint32_t *color, *uv;
+   unsigned count; // Glyphs in the current stream
+   unsigned glyphs; // Glyphs recorded this frame
+   glyph_upload *uploads;
+   unsigned upload_count, upload_capacity;
+} text_frame;
+
+struct core;
+
+// Allocates the atlas and layout cache and rasterizes printable ASCII;
+// no GL calls
+bool text_init(text_renderer *text);
+void text_deinit(text_renderer *text);
+
+// Create the atlas texture from the CPU copy. Must not run while a frame
+// is being simulated.
+bool text_gl_init(struct core *core, text_renderer *text);
+void text_gl_deinit(text_renderer *text);
+
+// Start recording a frame's text into cb at layer
+void text_begin(text_frame *frame, text_renderer *text, frame_arena *arena,
+      command_buffer *cb, unsigned layer);
+// Draw UTF-8 text with its top-left corner at (x, y) pixels, size pixels
+// per line of the 8-pixel font, in RGBA8 color. '\n' starts a new line.
+void text_draw(text_frame *frame, const char *str, float x, float y, float size, uint32_t color);
+// Record what is left of the frame's glyphs
+void text_end(text_frame *frame);
+
+// Upload glyphs rasterized while simulating a frame; instance thread only
+void text_apply_uploads(text_renderer *text, const gpu_caps *caps, const glyph_upload *uploads, unsigned count);
+
+#endif // TEXT_H
@@ -0,0 +1,223 @@
+#include "tilemap.h"
+#include "core.h"
+#include "alloc.h"
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define CHUNK_MAX_VERTICES (TILEMAP_CHUNK_TILES * TILEMAP_CHUNK_TILES * 6)
+
+// 8 bytes: chunk-relative 12.4 fixed-point pixels, so a chunk may span
+// up to 2048 pixels
+typedef struct tile_vertex {
+   int16_t x, y;
+   uint32_t color; // RGBA8
+} tile_vertex;
+
+static const gpu_vertex_format tile_format = { sizeof(tile_vertex), 2, {
+   { 0, 2, GPU_ATTRIB_PIXEL, offsetof(tile_vertex, x) },
+   { 1, 4, GPU_ATTRIB_UNORM8, offsetof(tile_vertex, color) },
+} };
+
+// Same pixel-to-clip mapping as draw_solid_quad and quad_batch, after
+// moving the chunk into camera space
+static const char *tile_vertex_shader_src =
+   "#version 330 core\n"
+   "layout(location = 0) in vec2 position;\n"
+   "layout(location = 1) in vec4 color;\n"
+   "uniform vec2 viewport;\n"
+   "uniform vec2 offset;\n" // Chunk origin minus camera, pixels
+   "uniform float depth;\n"
+   "out vec4 v_color;\n"
+   "void main() {\n"
+   "   vec2 pixel = offset + position * (1.0 / 16.0);\n"
+   "   gl_Position = vec4(pixel.x / viewport.x * 2.0 - 1.0, 1.0 - pixel.y / viewport.y * 2.0, depth * 2.0 - 1.0, 1.0);\n"
+   "   v_color = color;\n"
+   "}\n";
+
+static const char *tile_fragment_shader_src =
+   "#version 330 core\n"
+   "in vec4 v_color;\n"
+   "out vec4 frag_color;\n"
+   "void main() {\n"
+   "   frag_color = v_color;\n"
+   "}\n";
+
+static void mark_all_dirty(tilemap *map) {
+   unsigned i;
+   for (i = 0; i < map->chunks_x * map->chunks_y; i++)
+      map->chunks[i].dirty = true;
+}
+
+bool tilemap_init(tilemap *map, unsigned width, unsigned height, float tile_size) {
+   memset(map, 0, sizeof(*map));
+   if (!width || !height || width > 65536 || height > 65536 ||
+         tile_size * TILEMAP_CHUNK_TILES >= 2048.0f)
+      return false;
+   map->width = width;
+   map->height = height;
+   map->tile_size = tile_size;
+   map->chunks_x = (width + TILEMAP_CHUNK_TILES - 1) / TILEMAP_CHUNK_TILES;
+   map->chunks_y = (height + TILEMAP_CHUNK_TILES - 1) / TILEMAP_CHUNK_TILES;
+   map->tiles = (uint8_t *)core_calloc((size_t)width * height, 1);
+   map->chunks = (tilemap_chunk *)core_calloc((size_t)map->chunks_x * map->chunks_y, sizeof(tilemap_chunk));
+   map->bake = core_malloc(CHUNK_MAX_VERTICES * sizeof(tile_vertex));
+   if (!map->tiles || !map->chunks || !map->bake) {
+      tilemap_deinit(map);
+      return false;
+   }
+   mark_all_dirty(map);
+   return true;
+}
+
+void tilemap_deinit(tilemap *map) {
+   tilemap_gl_deinit(map);
+   core_free(map->tiles);
+   core_free(map->chunks);
+   core_free(map->bake);
+   memset(map, 0, sizeof(*map));
+}
+
+bool tilemap_gl_init(core_t *core, tilemap *map) {
+   map->program = core_create_shader_program(core, tile_vertex_shader_src, tile_fragment_shader_src, "Tilemap");
+   if (!map->program)
+      return false;
+   map->viewport_loc = glGetUniformLocation(map->program, "viewport");
+   map->offset_loc = glGetUniformLocation(map->program, "offset");
+   map->depth_loc = glGetUniformLocation(map->program, "depth");
+   return true;
+}
+
+void tilemap_gl_deinit(tilemap *map) {
+   unsigned i;
+   if (map->program)
+      glDeleteProgram(map->program);
+   map->program = 0;
+   if (!map->chunks)
+      return;
+   for (i = 0; i < map->chunks_x * map->chunks_y; i++) {
+      tilemap_chunk *chunk = &map->chunks[i];
+      if (chunk->vbo)
+         glDeleteBuffers(1, &chunk->vbo);
+      if (chunk->vao)
+         glDeleteVertexArrays(1, &chunk->vao);
+      chunk->vao = chunk->vbo = 0;
+      chunk->vertex_count = 0;
+      chunk->dirty = true;
+   }
+}
+
+void tilemap_set_tile(tilemap *map, unsigned x, unsigned y, uint8_t id) {
+   uint8_t *tile;
+   if (x >= map->width || y >= map->height)
+      return;
+   tile = &map->tiles[(size_t)y * map->width + x];
+   if (*tile == id)
+      return;
+   *tile = id;
+   map->chunks[(y / TILEMAP_CHUNK_TILES) * map->chunks_x + x / TILEMAP_CHUNK_TILES].dirty = true;
+}
+
+uint8_t tilemap_get_tile(const tilemap *map, unsigned x, unsigned y) {
+   if (x >= map->width || y >= map->height)
+      return 0;
+   return map->tiles[(size_t)y * map->width + x];
+}
+
+void tilemap_set_palette(tilemap *map, uint8_t id, uint32_t color) {
+   if (map->palette[id] == color)
+      return;
+   map->palette[id] = color;
+   mark_all_dirty(map);
+}
+
+// Bake a chunk's non-empty tiles into two triangles each and upload them
+// as the chunk's whole buffer
+static void bake_chunk(tilemap *map, unsigned cx, unsigned cy) {
+   tilemap_chunk *chunk = &map->chunks[cy * map->chunks_x + cx];
+   tile_vertex *v = (tile_vertex *)map->bake;
+   unsigned x0 = cx * TILEMAP_CHUNK_TILES, y0 = cy * TILEMAP_CHUNK_TILES;
+   unsigned x1 = x0 + TILEMAP_CHUNK_TILES, y1 = y0 + TILEMAP_CHUNK_TILES;
+   unsigned x, y, n = 0;
+   if (x1 > map->width)
+      x1 = map->width;
+   if (y1 > map->height)
+      y1 = map->height;
+
+   for (y = y0; y < y1; y++) {
+      const uint8_t *row = &map->tiles[(size_t)y * map->width];
+      for (x = x0; x < x1; x++) {
+         uint8_t id = row[x];
+         if (!id)
+            continue;
+         int16_t l = gpu_pack_pixel((x - x0) * map->tile_size), t = gpu_pack_pixel((y - y0) * map->tile_size);
+         int16_t r = gpu_pack_pixel((x - x0 + 1) * map->tile_size), b = gpu_pack_pixel((y - y0 + 1) * map->tile_size);
+         uint32_t c = map->palette[id];
+         tile_vertex quad[6] = {
+            { l, t, c }, { r, t, c }, { l, b, c },
+            { l, b, c }, { r, t, c }, { r, b, c },
+         };
+         memcpy(v + n, quad, sizeof(quad));
+         n += 6;
+      }
+   }
+
+   if (!chunk->vao) {
+      glGenVertexArrays(1, &chunk->vao);
+      glGenBuffers(1, &chunk->vbo);
+      glBindVertexArray(chunk->vao);
+      glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+      gpu_vertex_format_apply(&tile_format, 0);
+   } else {
+      glBindBuffer(GL_ARRAY_BUFFER, chunk->vbo);
+   }
+   // Respecify rather than update in place: a rebuilt chunk gets fresh
+   // storage and never waits on a draw still reading the old one
+   glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(n * sizeof(tile_vertex)), n ? v : NULL, GL_STATIC_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   chunk->vertex_count = n;
+   chunk->dirty = false;
+   map->rebuilds++;
+}
+
+// Chunk index range [*first, *last] covering [lo, lo + extent) pixels;
+// false when it misses the map
+static bool visible_range(float lo, float extent, float chunk_px, unsigned count,
+      unsigned *first, unsigned *last) {
+   float hi = lo + extent;
+   if (hi <= 0.0f || lo >= chunk_px * count)
+      return false;
+   *first = lo > 0.0f ? (unsigned)(lo / chunk_px) : 0;
+   *last = (unsigned)ceilf(hi / chunk_px) - 1;
+   if (*last >= count)
+      *last = count - 1;
+   return true;
+}
+
+unsigned tilemap_draw(tilemap *map, float cam_x, float cam_y, float vp_width, float vp_height, float depth) {
+   float chunk_px = map->tile_size * TILEMAP_CHUNK_TILES;
+   unsigned cx0, cx1, cy0, cy1, cx, cy, draws = 0;
+   if (!map->program || !map->chunks)
+      return 0;
+   if (!visible_range(cam_x, vp_width, chunk_px, map->chunks_x, &cx0, &cx1) ||
+         !visible_range(cam_y, vp_height, chunk_px, map->chunks_y, &cy0, &cy1))
+      return 0;
+
+   glUseProgram(map->program);
+   glUniform2f(map->viewport_loc, vp_width, vp_height);
+   glUniform1f(map->depth_loc, depth);
+   for (cy = cy0; cy <= cy1; cy++) {
+      for (cx = cx0; cx <= cx1; cx++) {
+         tilemap_chunk *chunk = &map->chunks[cy * map->chunks_x + cx];
+         if (chunk->dirty)
+            bake_chunk(map, cx, cy);
+         if (!chunk->vertex_count)
+            continue;
+         glUniform2f(map->offset_loc, cx * chunk_px - cam_x, cy * chunk_px - cam_y);
+         glBindVertexArray(chunk->vao);
+         glDrawArrays(GL_TRIANGLES, 0, (GLsizei)chunk->vertex_count);
+         draws++;
+      }
+   }
+   return draws;
+}
@@ -0,0 +1,72 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+#include "gpu.h"
+
+#define TILEMAP_CHUNK_TILES 16 // Chunks are 16x16 tiles
+#define TILEMAP_PALETTE_SIZE 256
+
+// Static tile layer. Tiles are grouped into fixed-size chunks, each baked
+// into its own VBO the first time it is visible and kept until one of its
+// tiles changes. Drawing only visits chunks that intersect the view, so a
+// frame costs one draw call per visible non-empty chunk however large the
+// world is.
+//
+// Tile data and chunk buffers belong to the instance thread: simulation
+// records edits in the render list and submission applies them.
+typedef struct tilemap_chunk {
+   GLuint vao, vbo;
+   unsigned vertex_count; // 0 = no visible tiles
+   bool dirty;            // Tiles changed (or never baked)
+} tilemap_chunk;
+
+typedef struct tilemap {
+   unsigned width, height;   // In tiles
+   float tile_size;          // Pixels
+   unsigned chunks_x, chunks_y;
+   uint8_t *tiles;           // width * height tile ids, row major
+   uint32_t palette[TILEMAP_PALETTE_SIZE]; // RGBA8 per id; id 0 is empty
+   tilemap_chunk *chunks;
+   void *bake;               // Scratch for one chunk's vertices
+
+   // GL objects, created by tilemap_gl_init() in a current context
+   GLuint program;
+   GLint viewport_loc, offset_loc, depth_loc;
+
+   unsigned rebuilds; // Chunks baked since init
+} tilemap;
+
+// One tile change recorded by simulation
+typedef struct tile_edit {
+   uint16_t x, y;
+   uint8_t id;
+} tile_edit;
+
+struct core;
+
+// Allocates tile storage (all empty); no GL calls. A chunk must span less
+// than 2048 pixels (tile_size under 128).
+bool tilemap_init(tilemap *map, unsigned width, unsigned height, float tile_size);
+void tilemap_deinit(tilemap *map);
+
+// Create the program; chunks are baked lazily when first drawn
+bool tilemap_gl_init(struct core *core, tilemap *map);
+// Free every GL object (context teardown); chunks rebake on next draw
+void tilemap_gl_deinit(tilemap *map);
+
+// Out-of-range coordinates are ignored
+void tilemap_set_tile(tilemap *map, unsigned x, unsigned y, uint8_t id);
+uint8_t tilemap_get_tile(const tilemap *map, unsigned x, unsigned y);
+// Changing a color rebakes every chunk
+void tilemap_set_palette(tilemap *map, uint8_t id, uint32_t color);
+
+// Draw the chunks intersecting the vp_width x vp_height view whose top-left
+// corner is at (cam_x, cam_y) world pixels, at window-space depth. Dirty
+// visible chunks are rebaked first. Leaves the tilemap program bound.
+// Returns the number of draw calls issued.
+unsigned tilemap_draw(tilemap *map, float cam_x, float cam_y, float vp_width, float vp_height, float depth);
+
+#endif // TILEMAP_H
@@ -0,0 +1,657 @@
+#include "vector.h"
+#include "core.h"
+#include "alloc.h"
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define FLATTEN_TOLERANCE 0.25f // Pixels between a curve and its chords
+#define FRINGE_HALF 0.5f        // Pixels on either side of an edge
+#define MITER_LIMIT 4.0f        // Longest miter, in half widths
+#define MAX_CURVE_SEGMENTS 100
+
+typedef struct vector_vertex {
+   float x, y;     // Path units
+   uint32_t color; // RGBA8, edge coverage in alpha
+} vector_vertex;
+
+// Indirect command layout glMultiDrawArraysIndirect reads
+typedef struct draw_arrays_command {
+   GLuint count, instance_count, first, base_instance;
+} draw_arrays_command;
+
+// Path units are scaled, then placed, then mapped like every other pixel
+// in the core
+static const char *vector_vertex_shader_src =
+   "#version 330 core\n"
+   "layout(location = 0) in vec2 position;\n"
+   "layout(location = 1) in vec4 color;\n"
+   "layout(location = 2) in vec4 placement;\n" // Origin x/y (pixels), scale, depth
+   "uniform vec2 viewport;\n"
+   "out vec4 v_color;\n"
+   "void main() {\n"
+   "   vec2 pixel = placement.xy + position * placement.z;\n"
+   "   gl_Position = vec4(pixel.x / viewport.x * 2.0 - 1.0, 1.0 - pixel.y / viewport.y * 2.0, placement.w * 2.0 - 1.0, 1.0);\n"
+   "   v_color = color;\n"
+   "}\n";
+
+static const char *vector_fragment_shader_src =
+   "#version 330 core\n"
+   "in vec4 v_color;\n"
+   "out vec4 frag_color;\n"
+   "void main() {\n"
+   "   frag_color = v_color;\n"
+   "}\n";
+
+// ---- Paths ----
+
+void vector_path_begin(vector_path *path) {
+   path->verb_count = path->point_count = 0;
+   path->overflowed = false;
+   path->hash = 0;
+}
+
+static void add_verb(vector_path *path, uint8_t verb, const float *pts, unsigned floats) {
+   if (path->verb_count == VECTOR_PATH_MAX_VERBS) {
+      path->overflowed = true;
+      return;
+   }
+   path->verbs[path->verb_count++] = verb;
+   memcpy(path->points + path->point_count, pts, floats * sizeof(float));
+   path->point_count += floats;
+}
+
+void vector_path_move_to(vector_path *path, float x, float y) {
+   float p[2] = { x, y };
+   add_verb(path, VECTOR_MOVE, p, 2);
+}
+
+void vector_path_line_to(vector_path *path, float x, float y) {
+   float p[2] = { x, y };
+   add_verb(path, VECTOR_LINE, p, 2);
+}
+
+void vector_path_quad_to(vector_path *path, float cx, float cy, float x, float y) {
+   float p[4] = { cx, cy, x, y };
+   add_verb(path, VECTOR_QUAD, p, 4);
+}
+
+void vector_path_cubic_to(vector_path *path, float c1x, float c1y, float c2x, float c2y, float x, float y) {
+   float p[6] = { c1x, c1y, c2x, c2y, x, y };
+   add_verb(path, VECTOR_CUBIC, p, 6);
+}
+
+void vector_path_close(vector_path *path) {
+   add_verb(path, VECTOR_CLOSE, NULL, 0);
+}
+
+void vector_path_end(vector_path *path) {
+   uint64_t h = 0xcbf29ce484222325ull;
+   const unsigned char *bytes;
+   size_t i, n;
+   for (i = 0; i < path->verb_count; i++)
+      h = (h ^ path->verbs[i]) * 0x100000001b3ull;
+   bytes = (const unsigned char *)path->points;
+   n = path->point_count * sizeof(float);
+   for (i = 0; i < n; i++)
+      h = (h ^ bytes[i]) * 0x100000001b3ull;
+   path->hash = h;
+}
+
+// ---- Tessellation ----
+
+typedef struct tessellator {
+   vector_vertex *out;
+   unsigned count;
+   bool truncated;
+   float *pts;   // Current contour, x/y pairs
+   unsigned n;
+   int *indices;
+   float tolerance; // Path units
+   float fringe;    // FRINGE_HALF in path units
+   float px;        // Pixels per path unit at the bucket's scale
+} tessellator;
+
+static uint32_t with_alpha(uint32_t color, float coverage) {
+   return (color & 0x00ffffffu) | ((uint32_t)((color >> 24) * coverage + 0.5f) << 24);
+}
+
+static void emit(tessellator *t, float x, float y, uint32_t color) {
+   if (t->count == VECTOR_MAX_VERTICES) {
+      t->truncated = true;
+      return;
+   }
+   t->out[t->count].x = x;
+   t->out[t->count].y = y;
+   t->out[t->count].color = color;
+   t->count++;
+}
+
+static void emit_triangle(tessellator *t, const float *a, const float *b, const float *c, uint32_t color) {
+   if (t->count + 3 > VECTOR_MAX_VERTICES) {
+      t->truncated = true;
+      return;
+   }
+   emit(t, a[0], a[1], color);
+   emit(t, b[0], b[1], color);
+   emit(t, c[0], c[1], color);
+}
+
+// Two triangles over a, b, c, d in order around the quad
+static void emit_quad(tessellator *t, const float *a, const float *b, const float *c, const float *d,
+      uint32_t ca, uint32_t cb, uint32_t cc, uint32_t cd) {
+   if (t->count + 6 > VECTOR_MAX_VERTICES) {
+      t->truncated = true;
+      return;
+   }
+   emit(t, a[0], a[1], ca);
+   emit(t, b[0], b[1], cb);
+   emit(t, c[0], c[1], cc);
+   emit(t, a[0], a[1], ca);
+   emit(t, c[0], c[1], cc);
+   emit(t, d[0], d[1], cd);
+}
+
+static void add_point(tessellator *t, float x, float y) {
+   if (t->n && fabsf(t->pts[t->n * 2 - 2] - x) < 1e-6f && fabsf(t->pts[t->n * 2 - 1] - y) < 1e-6f)
+      return;
+   if (t->n == VECTOR_MAX_CONTOUR) {
+      t->truncated = true;
+      return;
+   }
+   t->pts[t->n * 2] = x;
+   t->pts[t->n * 2 + 1] = y;
+   t->n++;
+}
+
+// Segment counts from Wang's formula: enough chords that none strays more
+// than the tolerance from the curve
+static unsigned curve_segments(float deviation, float factor, float tolerance) {
+   float n = ceilf(sqrtf(deviation * factor / tolerance));
+   return n < 1.0f ? 1 : n > MAX_CURVE_SEGMENTS ? MAX_CURVE_SEGMENTS : (unsigned)n;
+}
+
+static void flatten_quad(tessellator *t, float x0, float y0, const float *p) {
+   float dx = x0 - 2.0f * p[0] + p[2], dy = y0 - 2.0f * p[1] + p[3];
+   unsigned i, n = curve_segments(sqrtf(dx * dx + dy * dy), 0.25f, t->tolerance);
+   for (i = 1; i <= n; i++) {
+      float s = (float)i / n, u = 1.0f - s;
+      add_point(t, u * u * x0 + 2.0f * u * s * p[0] + s * s * p[2],
+            u * u * y0 + 2.0f * u * s * p[1] + s * s * p[3]);
+   }
+}
+
+static void flatten_cubic(tessellator *t, float x0, float y0, const float *p) {
+   float ax = x0 - 2.0f * p[0] + p[2], ay = y0 - 2.0f * p[1] + p[3];
+   float bx = p[0] - 2.0f * p[2] + p[4], by = p[1] - 2.0f * p[3] + p[5];
+   float d = fmaxf(sqrtf(ax * ax + ay * ay), sqrtf(bx * bx + by * by));
+   unsigned i, n = curve_segments(d, 0.75f, t->tolerance);
+   for (i = 1; i <= n; i++) {
+      float s = (float)i / n, u = 1.0f - s;
+      float w0 = u * u * u, w1 = 3.0f * u * u * s, w2 = 3.0f * u * s * s, w3 = s * s * s;
+      add_point(t, w0 * x0 + w1 * p[0] + w2 * p[2] + w3 * p[4],
+            w0 * y0 + w1 * p[1] + w2 * p[3] + w3 * p[5]);
+   }
+}
+
+// Unit normal of the edge a -> b, to the left of travel in y-down space
+static void edge_normal(const float *a, const float *b, float *n) {
+   float dx = b[0] - a[0], dy = b[1] - a[1];
+   float len = sqrtf(dx * dx + dy * dy);
+   if (len < 1e-12f) {
+      n[0] = n[1] = 0.0f;
+      return;
+   }
+   n[0] = dy / len;
+   n[1] = -dx / len;
+}
+
+// Miter direction between two edge normals, scaled so that offsetting by
+// it moves both edges by one unit (up to MITER_LIMIT)
+static void miter(const float *n0, const float *n1, float *m) {
+   float mx = n0[0] + n1[0], my = n0[1] + n1[1];
+   float len = sqrtf(mx * mx + my * my), c;
+   if (len < 1e-6f) {
+      m[0] = n0[0];
+      m[1] = n0[1];
+      return;
+   }
+   mx /= len;
+   my /= len;
+   c = mx * n0[0] + my * n0[1];
+   if (c < 1.0f / MITER_LIMIT)
+      c = 1.0f / MITER_LIMIT;
+   m[0] = mx / c;
+   m[1] = my / c;
+}
+
+static float cross(const float *a, const float *b, const float *c) {
+   return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+static bool in_triangle(const float *p, const float *a, const float *b, const float *c, float orient) {
+   return cross(a, b, p) * orient > 0.0f && cross(b, c, p) * orient > 0.0f && cross(c, a, p) * orient > 0.0f;
+}
+
+// Fill the current contour: interior by ear clipping over positions inset
+// by half a pixel, then a fringe fading out to half a pixel outside
+static void fill_contour(tessellator *t, uint32_t color) {
+   float *p = t->pts, area = 0.0f, orient, *inset, *outset;
+   unsigned n = t->n, i, m;
+   int *idx = t->indices;
+   if (n > 3 && fabsf(p[0] - p[n * 2 - 2]) < 1e-6f && fabsf(p[1] - p[n * 2 - 1]) < 1e-6f)
+      n--;
+   if (n < 3)
+      return;
+   for (i = 0; i < n; i++) {
+      unsigned j = (i + 1) % n;
+      area += p[i * 2] * p[j * 2 + 1] - p[j * 2] * p[i * 2 + 1];
+   }
+   if (fabsf(area) < 1e-12f)
+      return;
+   orient = area > 0.0f ? 1.0f : -1.0f;
+
+   // Offsets go after the contour in the same scratch block
+   inset = p + VECTOR_MAX_CONTOUR * 2;
+   outset = inset + VECTOR_MAX_CONTOUR * 2;
+   for (i = 0; i < n; i++) {
+      float n0[2], n1[2], mv[2];
+      edge_normal(&p[((i + n - 1) % n) * 2], &p[i * 2], n0);
+      edge_normal(&p[i * 2], &p[((i + 1) % n) * 2], n1);
+      miter(n0, n1, mv);
+      // Normals point outward for positive area (clockwise in y-down)
+      mv[0] *= orient * t->fringe;
+      mv[1] *= orient * t->fringe;
+      inset[i * 2] = p[i * 2] - mv[0];
+      inset[i * 2 + 1] = p[i * 2 + 1] - mv[1];
+      outset[i * 2] = p[i * 2] + mv[0];
+      outset[i * 2 + 1] = p[i * 2 + 1] + mv[1];
+   }
+
+   for (i = 0; i < n; i++)
+      idx[i] = (int)i;
+   m = n;
+   while (m > 3 && !t->truncated) {
+      unsigned k, ear = 0;
+      bool found = false;
+      for (k = 0; k < m && !found; k++) {
+         const float *a = &p[idx[(k + m - 1) % m] * 2], *b = &p[idx[k] * 2], *c = &p[idx[(k + 1) % m] * 2];
+         unsigned q;
+         if (cross(a, b, c) * orient <= 0.0f)
+            continue;
+         found = true;
+         for (q = 0; q < m && found; q++) {
+            const float *v = &p[idx[q] * 2];
+            if (v != a && v != b && v != c && in_triangle(v, a, b, c, orient))
+               found = false;
+         }
+         if (found)
+            ear = k;
+      }
+      // Without an ear (degenerate leftovers) clip the first vertex anyway
+      // so the loop ends
+      emit_triangle(t, &inset[idx[(ear + m - 1) % m] * 2], &inset[idx[ear] * 2],
+            &inset[idx[(ear + 1) % m] * 2], color);
+      memmove(&idx[ear], &idx[ear + 1], (m - ear - 1) * sizeof(int));
+      m--;
+   }
+   emit_triangle(t, &inset[idx[0] * 2], &inset[idx[1] * 2], &inset[idx[2] * 2], color);
+
+   for (i = 0; i < n; i++) {
+      unsigned j = (i + 1) % n;
+      emit_quad(t, &inset[i * 2], &inset[j * 2], &outset[j * 2], &outset[i * 2],
+            color, color, with_alpha(color, 0.0f), with_alpha(color, 0.0f));
+   }
+}
+
+// Stroke the current contour as a strip four vertices wide: fringe, core,
+// core, fringe. Strokes thinner than a pixel keep a one-pixel footprint
+// and fade instead.
+static void stroke_contour(tessellator *t, uint32_t color, float width, bool closed) {
+   float *p = t->pts, *offs = t->pts + VECTOR_MAX_CONTOUR * 2;
+   float half = width * 0.5f, core_half, outer, coverage = width * t->px;
+   unsigned n = t->n, i, segments;
+   uint32_t solid, clear;
+   if (closed && n > 2 && fabsf(p[0] - p[n * 2 - 2]) < 1e-6f && fabsf(p[1] - p[n * 2 - 1]) < 1e-6f)
+      n--;
+   if (n < 2)
+      return;
+   core_half = half - t->fringe;
+   if (core_half < 0.0f)
+      core_half = 0.0f;
+   outer = core_half + 2.0f * t->fringe;
+   solid = with_alpha(color, coverage < 1.0f ? coverage : 1.0f);
+   clear = with_alpha(color, 0.0f);
+
+   for (i = 0; i < n; i++) {
+      float n0[2] = { 0.0f, 0.0f }, n1[2] = { 0.0f, 0.0f }, mv[2];
+      bool first = i == 0 && !closed, last = i == n - 1 && !closed;
+      if (!first)
+         edge_normal(&p[((i + n - 1) % n) * 2], &p[i * 2], n0);
+      if (!last)
+         edge_normal(&p[i * 2], &p[((i + 1) % n) * 2], n1);
+      if (first)
+         n0[0] = n1[0], n0[1] = n1[1];
+      if (last)
+         n1[0] = n0[0], n1[1] = n0[1];
+      miter(n0, n1, mv);
+      offs[i * 2] = mv[0];
+      offs[i * 2 + 1] = mv[1];
+   }
+
+   segments = closed ? n : n - 1;
+   for (i = 0; i < segments; i++) {
+      unsigned j = (i + 1) % n;
+      float a[4][2], b[4][2];
+      const float w[4] = { outer, core_half, -core_half, -outer };
+      unsigned k;
+      for (k = 0; k < 4; k++) {
+         a[k][0] = p[i * 2] + offs[i * 2] * w[k];
+         a[k][1] = p[i * 2 + 1] + offs[i * 2 + 1] * w[k];
+         b[k][0] = p[j * 2] + offs[j * 2] * w[k];
+         b[k][1] = p[j * 2 + 1] + offs[j * 2 + 1] * w[k];
+      }
+      emit_quad(t, a[0], b[0], b[1], a[1], clear, clear, solid, solid);
+      emit_quad(t, a[1], b[1], b[2], a[2], solid, solid, solid, solid);
+      emit_quad(t, a[2], b[2], b[3], a[3], solid, solid, clear, clear);
+   }
+}
+
+static void finish_contour(tessellator *t, const vector_style *style, bool closed) {
+   if (style->fill >> 24)
+      fill_contour(t, style->fill);
+   if ((style->stroke >> 24) && style->stroke_width > 0.0f)
+      stroke_contour(t, style->stroke, style->stroke_width, closed);
+   t->n = 0;
+}
+
+// Fills go first so strokes cover their edges
+static void tessellate(tessellator *t, const vector_path *path, const vector_style *style) {
+   const float *pts = path->points;
+   float x = 0.0f, y = 0.0f, sx = 0.0f, sy = 0.0f;
+   unsigned i;
+   t->n = 0;
+   for (i = 0; i < path->verb_count; i++) {
+      switch (path->verbs[i]) {
+      case VECTOR_MOVE:
+         if (t->n)
+            finish_contour(t, style, false);
+         x = sx = pts[0];
+         y = sy = pts[1];
+         add_point(t, x, y);
+         pts += 2;
+         break;
+      case VECTOR_LINE:
+         if (!t->n)
+            add_point(t, x, y);
+         x = pts[0];
+         y = pts[1];
+         add_point(t, x, y);
+         pts += 2;
+         break;
+      case VECTOR_QUAD:
+         if (!t->n)
+            add_point(t, x, y);
+         flatten_quad(t, x, y, pts);
+         x = pts[2];
+         y = pts[3];
+         pts += 4;
+         break;
+      case VECTOR_CUBIC:
+         if (!t->n)
+            add_point(t, x, y);
+         flatten_cubic(t, x, y, pts);
+         x = pts[4];
+         y = pts[5];
+         pts += 6;
+         break;
+      case VECTOR_CLOSE:
+         if (t->n)
+            finish_contour(t, style, true);
+         x = sx;
+         y = sy;
+         break;
+      }
+   }
+   if (t->n)
+      finish_contour(t, style, false);
+}
+
+// ---- Cache ----
+
+// Point the VAO's vertex attributes at the shared buffer
+static void bind_vertex_buffer(vector_cache *cache) {
+   glBindVertexArray(cache->vao);
+   glBindBuffer(GL_ARRAY_BUFFER, cache->vbo);
+   glEnableVertexAttribArray(0);
+   glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(vector_vertex), (void *)0);
+   glEnableVertexAttribArray(1);
+   glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(vector_vertex), (void *)offsetof(vector_vertex, color));
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   glBindVertexArray(0);
+}
+
+static GLuint create_vertex_buffer(unsigned vertices) {
+   GLuint vbo;
+   glGenBuffers(1, &vbo);
+   glBindBuffer(GL_ARRAY_BUFFER, vbo);
+   glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertices * sizeof(vector_vertex), NULL, GL_STATIC_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   return vbo;
+}
+
+bool vector_cache_init(core_t *core, vector_cache *cache) {
+   memset(cache, 0, sizeof(*cache));
+   cache->caps = &core->gpu;
+   cache->vertices = core_malloc(VECTOR_MAX_VERTICES * sizeof(vector_vertex));
+   // Contour, then fill insets and outsets (or stroke offsets)
+   cache->contour = (float *)core_malloc(VECTOR_MAX_CONTOUR * 2 * 3 * sizeof(float));
+   cache->indices = (int *)core_malloc(VECTOR_MAX_CONTOUR * sizeof(int));
+   cache->program = core_create_shader_program(core, vector_vertex_shader_src, vector_fragment_shader_src, "Vector");
+   if (!cache->vertices || !cache->contour || !cache->indices || !cache->program) {
+      vector_cache_deinit(cache);
+      return false;
+   }
+   cache->viewport_loc = glGetUniformLocation(cache->program, "viewport");
+
+   glGenVertexArrays(1, &cache->vao);
+   cache->buffer_vertices = VECTOR_BUFFER_VERTICES;
+   cache->vbo = create_vertex_buffer(cache->buffer_vertices);
+   bind_vertex_buffer(cache);
+   if (cache->caps->multi_draw_indirect) {
+      if (!gpu_stream_init(&cache->draws, cache->caps,
+            VECTOR_DRAW_BATCH * (sizeof(draw_arrays_command) + 4 * sizeof(float)) * 4)) {
+         vector_cache_deinit(cache);
+         return false;
+      }
+      // Placements come from the stream, one per command's base instance
+      glBindVertexArray(cache->vao);
+      glEnableVertexAttribArray(2);
+      glVertexAttribDivisor(2, 1);
+      glBindVertexArray(0);
+   }
+   return true;
+}
+
+void vector_cache_deinit(vector_cache *cache) {
+   if (cache->draws.buffer)
+      gpu_stream_deinit(&cache->draws);
+   if (cache->vbo)
+      glDeleteBuffers(1, &cache->vbo);
+   if (cache->vao)
+      glDeleteVertexArrays(1, &cache->vao);
+   if (cache->program)
+      glDeleteProgram(cache->program);
+   core_free(cache->vertices);
+   core_free(cache->contour);
+   core_free(cache->indices);
+   memset(cache, 0, sizeof(*cache));
+}
+
+static bool same_style(const vector_style *a, const vector_style *b) {
+   return a->fill == b->fill && a->stroke == b->stroke && a->stroke_width == b->stroke_width;
+}
+
+// Copy the live meshes back to back into a buffer with room for at least
+// needed more vertices, dropping the space of rebuilt and evicted ones.
+// GPU to GPU, so nothing is tessellated again.
+static void compact(vector_cache *cache, unsigned needed) {
+   unsigned live = 0, size = cache->buffer_vertices, head = 0, i;
+   GLuint vbo;
+   for (i = 0; i < VECTOR_CACHE_ENTRIES; i++)
+      live += cache->meshes[i].last_used ? cache->meshes[i].vertex_count : 0;
+   while (size < (live + needed) * 2)
+      size *= 2;
+
+   vbo = create_vertex_buffer(size);
+   glBindBuffer(GL_COPY_READ_BUFFER, cache->vbo);
+   glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+   for (i = 0; i < VECTOR_CACHE_ENTRIES; i++) {
+      vector_mesh *m = &cache->meshes[i];
+      if (!m->last_used || !m->vertex_count) {
+         m->capacity = 0;
+         continue;
+      }
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)m->first * sizeof(vector_vertex),
+            (GLintptr)head * sizeof(vector_vertex), (GLsizeiptr)m->vertex_count * sizeof(vector_vertex));
+      m->first = head;
+      m->capacity = m->vertex_count;
+      head += m->vertex_count;
+   }
+   glBindBuffer(GL_COPY_READ_BUFFER, 0);
+   glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+   glDeleteBuffers(1, &cache->vbo);
+   cache->vbo = vbo;
+   cache->buffer_vertices = size;
+   cache->buffer_head = head;
+   cache->compactions++;
+   bind_vertex_buffer(cache);
+}
+
+// Build the mesh for its key into the shared buffer: over its old
+// vertices if they have room, else at the end
+static void build_mesh(vector_cache *cache, vector_mesh *mesh, const vector_path *path,
+      const vector_style *style, float bucket_scale) {
+   tessellator t;
+   memset(&t, 0, sizeof(t));
+   t.out = (vector_vertex *)cache->vertices;
+   t.pts = cache->contour;
+   t.indices = cache->indices;
+   t.px = bucket_scale;
+   t.tolerance = FLATTEN_TOLERANCE / bucket_scale;
+   t.fringe = FRINGE_HALF / bucket_scale;
+   tessellate(&t, path, style);
+
+   mesh->vertex_count = t.count;
+   if (t.count > mesh->capacity) {
+      mesh->capacity = 0; // Not copied if compacting
+      if (cache->buffer_head + t.count > cache->buffer_vertices)
+         compact(cache, t.count);
+      mesh->first = cache->buffer_head;
+      mesh->capacity = t.count;
+      cache->buffer_head += t.count;
+   }
+   if (t.count)
+      gpu_buffer_update(cache->caps, cache->vbo, (GLintptr)mesh->first * sizeof(vector_vertex),
+            (GLsizeiptr)t.count * sizeof(vector_vertex), t.out);
+   cache->tessellations++;
+}
+
+// The cached mesh for a path, built on a miss
+static vector_mesh *find_mesh(vector_cache *cache, const vector_path *path, const vector_style *style,
+      float scale, bool *built) {
+   vector_mesh *mesh = NULL;
+   int bucket = (int)floorf(log2f(scale) * 2.0f + 0.5f);
+   unsigned i;
+
+   for (i = 0; i < VECTOR_CACHE_ENTRIES; i++) {
+      vector_mesh *m = &cache->meshes[i];
+      if (m->last_used && m->path_hash == path->hash && m->bucket == bucket && same_style(&m->style, style)) {
+         mesh = m;
+         break;
+      }
+      if (!mesh || m->last_used < mesh->last_used)
+         mesh = m;
+   }
+   if (i == VECTOR_CACHE_ENTRIES) {
+      mesh->path_hash = path->hash;
+      mesh->style = *style;
+      mesh->bucket = bucket;
+      // Counted live while compacting; its old vertices are not
+      mesh->last_used = 0;
+      build_mesh(cache, mesh, path, style, exp2f(bucket * 0.5f));
+      *built = true;
+   }
+   mesh->last_used = ++cache->tick;
+   return mesh;
+}
+
+unsigned vector_draw_list(vector_cache *cache, const vector_draw_params *draws, unsigned count,
+      float vp_width, float vp_height, unsigned *built) {
+   // Meshes are resolved (and built, which may move the buffer) before any
+   // draw is issued. A list never outgrows the cache, so none of them is
+   // evicted by a later one.
+   const vector_mesh *meshes[VECTOR_DRAW_BATCH];
+   unsigned i, n = 0, calls = 0;
+   if (!cache->program)
+      return 0;
+   if (count > VECTOR_DRAW_BATCH)
+      count = VECTOR_DRAW_BATCH;
+   for (i = 0; i < count; i++) {
+      bool miss = false;
+      meshes[i] = draws[i].scale > 0.0f ? find_mesh(cache, draws[i].path, draws[i].style, draws[i].scale, &miss) : NULL;
+      if (miss)
+         (*built)++;
+      if (meshes[i] && meshes[i]->vertex_count)
+         n++;
+   }
+
+   glUseProgram(cache->program);
+   glUniform2f(cache->viewport_loc, vp_width, vp_height);
+   glBindVertexArray(cache->vao);
+   if (!n)
+      return 0;
+
+   if (cache->caps->multi_draw_indirect) {
+      // Commands, then the placements their base instances index
+      GLsizeiptr commands_size = (GLsizeiptr)n * sizeof(draw_arrays_command);
+      GLintptr offset;
+      uint8_t *dst = (uint8_t *)gpu_stream_map(&cache->draws, commands_size + (GLsizeiptr)n * 4 * sizeof(float), &offset);
+      draw_arrays_command *cmd = (draw_arrays_command *)dst;
+      float *placement;
+      unsigned d = 0;
+      if (!dst)
+         return 0;
+      placement = (float *)(dst + commands_size);
+      for (i = 0; i < count; i++) {
+         if (!meshes[i] || !meshes[i]->vertex_count)
+            continue;
+         cmd[d].count = meshes[i]->vertex_count;
+         cmd[d].instance_count = 1;
+         cmd[d].first = meshes[i]->first;
+         cmd[d].base_instance = d;
+         placement[d * 4 + 0] = draws[i].x;
+         placement[d * 4 + 1] = draws[i].y;
+         placement[d * 4 + 2] = draws[i].scale;
+         placement[d * 4 + 3] = draws[i].depth;
+         d++;
+      }
+      gpu_stream_unmap(&cache->draws);
+      glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)(uintptr_t)(offset + commands_size));
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, cache->draws.buffer);
+      glMultiDrawArraysIndirect(GL_TRIANGLES, (const void *)(uintptr_t)offset, (GLsizei)n, 0);
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+      return 1;
+   }
+
+   // Disabled arrays read the current generic attribute value
+   for (i = 0; i < count; i++) {
+      if (!meshes[i] || !meshes[i]->vertex_count)
+         continue;
+      glVertexAttrib4f(2, draws[i].x, draws[i].y, draws[i].scale, draws[i].depth);
+      glDrawArrays(GL_TRIANGLES, (GLint)meshes[i]->first, (GLsizei)meshes[i]->vertex_count);
+      calls++;
+   }
+   return calls;
+}
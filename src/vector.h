@@ -0,0 +1,122 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <glad/glad.h>
+#include "gpu.h"
+
+#define VECTOR_PATH_MAX_VERBS 64   // Verbs per path
+#define VECTOR_CACHE_ENTRIES 64    // Cached meshes
+#define VECTOR_MAX_VERTICES 16384  // Per mesh
+#define VECTOR_MAX_CONTOUR 1024    // Flattened points per contour
+#define VECTOR_BUFFER_VERTICES 65536 // Initial size of the shared vertex buffer
+#define VECTOR_DRAW_BATCH 32       // Paths per vector_draw_list call
+
+enum vector_verb {
+   VECTOR_MOVE,  // 1 point
+   VECTOR_LINE,  // 1 point
+   VECTOR_QUAD,  // Control point, end point
+   VECTOR_CUBIC, // Two control points, end point
+   VECTOR_CLOSE  // 0 points
+};
+
+// A path in its own units: contours of lines and quadratic and cubic
+// Béziers. Fixed storage, so building one never allocates; the hash is
+// taken by vector_path_end() and identifies the path in the mesh cache.
+typedef struct vector_path {
+   uint8_t verbs[VECTOR_PATH_MAX_VERBS];
+   float points[VECTOR_PATH_MAX_VERBS * 6];
+   unsigned verb_count, point_count; // point_count counts floats
+   bool overflowed; // Ran out of verbs; later segments were dropped
+   uint64_t hash;
+} vector_path;
+
+typedef struct vector_style {
+   uint32_t fill;      // RGBA8; alpha 0 = no fill
+   uint32_t stroke;    // RGBA8; alpha 0 = no stroke
+   float stroke_width; // Path units
+} vector_style;
+
+void vector_path_begin(vector_path *path);
+void vector_path_move_to(vector_path *path, float x, float y);
+void vector_path_line_to(vector_path *path, float x, float y);
+void vector_path_quad_to(vector_path *path, float cx, float cy, float x, float y);
+void vector_path_cubic_to(vector_path *path, float c1x, float c1y, float c2x, float c2y, float x, float y);
+void vector_path_close(vector_path *path);
+void vector_path_end(vector_path *path);
+
+// Tessellated meshes keyed by path, style and scale bucket (half an octave
+// wide), packed into one shared vertex buffer. Curves are flattened to a
+// quarter pixel at the bucket's scale. Each closed contour is filled on
+// its own (ear clipping, so concave outlines work but holes don't);
+// strokes follow every contour with miter joins and butt caps.
+// Antialiasing comes from a one-pixel fringe around every edge whose alpha
+// falls to zero, so a mesh needs no multisampling and draws with plain
+// alpha blending.
+//
+// A path that is drawn again at a scale in the same bucket reuses its
+// mesh: no tessellation. When the cache is full, the least recently drawn
+// mesh is rebuilt for the new key, in place if it still fits; otherwise
+// it is appended, and when the buffer runs out the live meshes are
+// compacted into a larger one on the GPU.
+//
+// A run of paths draws as one list. Per-draw placement (origin, scale,
+// depth) is an instanced attribute. With multi-draw indirect the list
+// becomes one glMultiDrawArraysIndirect over the shared buffer, each
+// command's base instance selecting its placement from a stream; on the
+// 3.3 baseline each path is a glDrawArrays with the placement set as a
+// constant attribute.
+//
+// GL objects and the cache belong to the instance thread; simulation
+// records paths by pointer, which must stay valid until submission.
+typedef struct vector_mesh {
+   uint64_t path_hash;
+   vector_style style;
+   int bucket;
+   uint64_t last_used; // Draw tick, 0 = empty
+   unsigned first;     // In the shared buffer, vertices
+   unsigned vertex_count;
+   unsigned capacity;  // Vertices reserved at first
+} vector_mesh;
+
+typedef struct vector_cache {
+   vector_mesh meshes[VECTOR_CACHE_ENTRIES];
+   uint64_t tick;
+   void *vertices; // Tessellation scratch, VECTOR_MAX_VERTICES
+   float *contour; // Flattening scratch, VECTOR_MAX_CONTOUR points
+   int *indices;   // Ear clipping scratch
+
+   const gpu_caps *caps;
+   GLuint vao, vbo;
+   unsigned buffer_vertices, buffer_head; // Capacity and first unreserved vertex
+   gpu_stream draws; // Indirect commands and placements, with multi-draw indirect
+
+   GLuint program;
+   GLint viewport_loc;
+
+   uint64_t tessellations; // Meshes built since init
+   uint64_t compactions;   // Times the shared buffer was repacked
+} vector_cache;
+
+// One path of a draw list, with its top-left origin at (x, y) pixels,
+// scaled, at window-space depth
+typedef struct vector_draw_params {
+   const vector_path *path;
+   const vector_style *style;
+   float x, y, scale, depth;
+} vector_draw_params;
+
+struct core;
+
+// Needs a current GL context
+bool vector_cache_init(struct core *core, vector_cache *cache);
+void vector_cache_deinit(vector_cache *cache);
+
+// Draw up to VECTOR_DRAW_BATCH paths in order, tessellating only cache
+// misses. Leaves the vector program and VAO bound. Returns the draw calls
+// issued; *built counts the meshes tessellated.
+unsigned vector_draw_list(vector_cache *cache, const vector_draw_params *draws, unsigned count,
+      float vp_width, float vp_height, unsigned *built);
+
+#endif // VECTOR_H